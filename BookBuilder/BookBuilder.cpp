@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "GameRecord.h"
+#include "OpeningBook.h"
+
+// Builds an opening book from recorded games (see GameRecord.h, SelfPlay
+// --record writes them).
+//
+//   BookBuilder <book> <games>... [--max-turns <n>] [--min-count <n>] [--update]
+//
+// Every move played in the first --max-turns turns of a game is counted for
+// the position it was played in, with the half points its side scored.
+// Unfinished games count as draws. Moves played fewer than --min-count times
+// are left out. --update adds the games to the counts already in the book
+// instead of starting over, so the book keeps learning from new games.
+
+struct Options {
+    std::string book;
+    std::vector<std::string> games;
+    int maxTurns = 20;
+    int minCount = 2;
+    bool update = false;
+};
+
+struct MoveStats {
+    uint64_t played = 0;
+    uint64_t halfPoints = 0;
+};
+
+// One move in one position
+struct PositionMove {
+    uint64_t key;
+    uint32_t move;
+
+    bool operator==(const PositionMove& o) const
+    {
+        return key == o.key && move == o.move;
+    }
+};
+
+struct PositionMoveHash {
+    size_t operator()(const PositionMove& p) const
+    {
+        return (size_t)(p.key ^ ((uint64_t)p.move * 0x9E3779B97F4A7C15ull));
+    }
+};
+
+// Half points the side to move scores from a result
+int HalfPoints(GameResult result, int side)
+{
+    if (result == GameResult::WhiteWins)
+        return side == White ? 2 : 0;
+    if (result == GameResult::BlackWins)
+        return side == Black ? 2 : 0;
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    Attacks::Init();
+
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--max-turns" && i + 1 < argc)
+            options.maxTurns = std::stoi(argv[++i]);
+        else if (arg == "--min-count" && i + 1 < argc)
+            options.minCount = std::max(std::stoi(argv[++i]), 1);
+        else if (arg == "--update")
+            options.update = true;
+        else if (!arg.empty() && arg[0] != '-')
+        {
+            if (options.book.empty())
+                options.book = arg;
+            else
+                options.games.push_back(arg);
+        }
+        else
+        {
+            options.games.clear();
+            break;
+        }
+    }
+    if (options.games.empty())
+    {
+        std::cerr << "usage: BookBuilder <book> <games>... [--max-turns <n>] [--min-count <n>] [--update]" << std::endl;
+        return 2;
+    }
+
+    std::unordered_map<PositionMove, MoveStats, PositionMoveHash> stats;
+    if (options.update)
+    {
+        // The book is closed again before it's written over
+        OpeningBook book;
+        if (!book.Open(options.book))
+        {
+            std::cerr << book.error << std::endl;
+            return 2;
+        }
+        for (const BookEntry& e : book.Entries())
+        {
+            MoveStats& s = stats[{ e.key, e.move }];
+            s.played += e.weight;
+            s.halfPoints += e.learn;
+        }
+        std::cout << "updating " << options.book << " (" << book.Size() << " entries)" << std::endl;
+    }
+    int games = 0;
+    int skipped = 0;
+    GameResult result;
+    std::vector<std::string> turns;
+    for (const std::string& path : options.games)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            std::cerr << "can't open " << path << std::endl;
+            return 2;
+        }
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.empty())
+                continue;
+            if (!ParseRecord(line, result, turns))
+            {
+                skipped++;
+                continue;
+            }
+            games++;
+
+            Match match;
+            match.Reset();
+            for (int t = 0; t < (int)turns.size() && t < options.maxTurns; t++)
+            {
+                Move m;
+                if (!BeginTurnToken(match, turns[t], m))
+                {
+                    std::cerr << path << ": game " << games << " has an illegal turn " << turns[t] << ", the rest is skipped" << std::endl;
+                    break;
+                }
+                if (m.IsNull())
+                {
+                    match.PlayTurn(m);
+                    continue;
+                }
+
+                // Keyed after the side has queued its unit, that's the position the AI looks up
+                MoveStats& s = stats[{ match.state.hash, m.Encode() }];
+                s.played++;
+                s.halfPoints += HalfPoints(result, match.state.sideToMove);
+                match.PlayTurn(m);
+            }
+        }
+    }
+
+    std::vector<BookEntry> entries;
+    for (const auto& [pm, s] : stats)
+        if (s.played >= (uint64_t)options.minCount)
+            entries.push_back({ pm.key, pm.move, (uint16_t)std::min<uint64_t>(s.played, 65535), (uint16_t)std::min<uint64_t>(s.halfPoints, 65535) });
+    if (!OpeningBook::Write(options.book, entries))
+    {
+        std::cerr << "can't write " << options.book << std::endl;
+        return 1;
+    }
+    std::cout << "games " << games << " skipped " << skipped << " entries " << entries.size() << " written to " << options.book << std::endl;
+    return 0;
+}
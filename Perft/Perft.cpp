@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "Fen.h"
+#include "Perft.h"
+
+// Command line perft for validating and timing the move generator.
+//
+//   Perft [depth] [--fen "<fen>"] [--divide] [--hash <MB>] [--threads <n>]
+//   Perft --verify [--hash <MB>] [--threads <n>]
+//
+// Prints the leaf count, time and nodes per second. --divide lists every root
+// move's count, --verify runs positions with published counts and fails with
+// a non-zero exit code on any mismatch.
+
+struct KnownPosition {
+    const char* name;
+    const char* fen;
+    int depth;
+    uint64_t nodes;
+};
+
+const KnownPosition KnownPositions[] = {
+    { "start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609 },
+    { "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603 },
+    { "endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624 },
+    { "promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333 },
+    { "tricky", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487 },
+    { "middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594 },
+};
+
+struct Timer {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    double Seconds() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+void PrintSpeed(uint64_t nodes, double seconds)
+{
+    std::cout << "nodes " << nodes << " time " << seconds << "s nps " << (uint64_t)(nodes / std::max(seconds, 1e-9)) << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    Attacks::Init();
+
+    std::string fen = StartFen;
+    int depth = 5;
+    bool divide = false;
+    bool verify = false;
+    size_t hashMB = 0;
+    int threads = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--fen" && i + 1 < argc)
+            fen = argv[++i];
+        else if (arg == "--divide")
+            divide = true;
+        else if (arg == "--verify")
+            verify = true;
+        else if (arg == "--hash" && i + 1 < argc)
+            hashMB = std::stoul(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = std::max(std::stoi(argv[++i]), 1);
+        else if (!arg.empty() && std::isdigit((unsigned char)arg[0]))
+            depth = std::stoi(arg);
+        else
+        {
+            std::cerr << "usage: Perft [depth] [--fen \"<fen>\"] [--divide] [--hash <MB>] [--threads <n>] [--verify]" << std::endl;
+            return 2;
+        }
+    }
+
+    std::unique_ptr<PerftCache> cache;
+    if (hashMB > 0)
+        cache = std::make_unique<PerftCache>(hashMB);
+
+    if (verify)
+    {
+        int failures = 0;
+        uint64_t total = 0;
+        Timer timer;
+        for (const KnownPosition& p : KnownPositions)
+        {
+            GameState state;
+            ParseFen(p.fen, state);
+            uint64_t nodes = 0;
+            for (const PerftDivide& d : PerftRootSplit(state, p.depth, threads, cache.get()))
+                nodes += d.nodes;
+            total += nodes;
+            bool ok = nodes == p.nodes;
+            failures += !ok;
+            std::cout << (ok ? "ok   " : "FAIL ") << p.name << " depth " << p.depth << " nodes " << nodes;
+            if (!ok)
+                std::cout << " expected " << p.nodes;
+            std::cout << std::endl;
+        }
+        PrintSpeed(total, timer.Seconds());
+        return failures ? 1 : 0;
+    }
+
+    GameState state;
+    if (!ParseFen(fen, state))
+    {
+        std::cerr << "could not read fen: " << fen << std::endl;
+        return 2;
+    }
+
+    Timer timer;
+    uint64_t nodes = 0;
+    if (depth > 0)
+    {
+        for (const PerftDivide& d : PerftRootSplit(state, depth, threads, cache.get()))
+        {
+            if (divide)
+                std::cout << d.move.ToString() << ": " << d.nodes << std::endl;
+            nodes += d.nodes;
+        }
+    }
+    else
+        nodes = 1;
+    PrintSpeed(nodes, timer.Seconds());
+    return 0;
+}
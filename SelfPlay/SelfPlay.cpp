@@ -0,0 +1,381 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "GameRecord.h"
+#include "OpeningBook.h"
+#include "Search.h"
+
+// Plays the game against itself without a window, for batch testing on
+// machines without a display.
+//
+//   SelfPlay [--games <n>] [--depth <d>] [--threads <n>] [--max-turns <n>] [--seed <n>] [--net <file>]
+//            [--book <file>] [--tables <dir>] [--record <file>] [--check]
+//   SelfPlay --search-threads <n> [--depth <d>] [--seed <n>] [--net <file>] [--tables <dir>]
+//   SelfPlay --check-net [--games <n>] [--max-turns <n>] [--seed <n>] [--net <file>]
+//
+// Depth 0 plays random legal moves, anything higher runs the AI search to that
+// depth. Games are spread over threads, each with its own search and a small
+// transposition table. --net has the search evaluate with a network file
+// instead of the hand-written evaluation. --book plays from an opening book
+// while it has moves, --tables has the search look up endings in a directory
+// of endgame tables (see TableGen) and --record appends every game to a file
+// in the GameRecord format, for BookBuilder. --check recomputes the hash and
+// the evaluation terms after every turn and fails on any difference from the
+// incremental ones.
+//
+// --search-threads benches one search over 1 to n threads instead of playing
+// games: every thread count searches the same positions, taken from random
+// games at fixed turns, to the same depth (9 unless --depth says otherwise),
+// and prints nodes per second and how much faster than one thread it got there.
+//
+// --check-net plays random games and checks the network's kernels at every
+// SIMD level the CPU has: after each turn the incrementally updated
+// accumulators have to equal a full refresh, and every level has to give the
+// scalar kernels' accumulators and evaluation. It uses --net, or random
+// weights when there's none.
+
+struct Options {
+    int games = 1000;
+    int depth = 0;
+    int threads = std::max((int)std::thread::hardware_concurrency(), 1);
+    int maxTurns = 300;
+    uint64_t seed = 1;
+    std::string net;
+    std::string book;
+    std::string tables;
+    std::string record;
+    bool check = false;
+    int searchThreads = 0; // benches the search up to this many threads instead of playing
+    bool checkNet = false;
+};
+
+struct Totals {
+    std::atomic<int> results[4] = {}; // indexed by GameResult
+    std::atomic<uint64_t> turns = 0;
+    std::atomic<int> desyncs = 0;
+    std::atomic<int> bookMoves = 0;
+    std::atomic<int> unitsTrained = 0;
+};
+
+// What the threads share besides the options
+struct Shared {
+    Nnue::Network network;
+    OpeningBook book;
+    Endgame::Tables tables;
+    std::ofstream record;
+    std::mutex recordMutex;
+};
+
+void PlayGames(const Options& options, Shared& shared, std::atomic<int>& nextGame, Totals& totals)
+{
+    TranspositionTable table = TranspositionTable(1);
+    Search search = Search(table);
+    search.SetNetwork(&shared.network);
+    search.SetTables(&shared.tables);
+    SearchLimits limits;
+    limits.depth = options.depth;
+    MoveList moves;
+
+    for (int game = nextGame++; game < options.games; game = nextGame++)
+    {
+        std::mt19937_64 random(options.seed + game);
+        Match match;
+        match.Reset();
+        table.Clear();
+
+        std::string line;
+        GameResult result = match.Result();
+        while (result == GameResult::Ongoing && match.turns < options.maxTurns)
+        {
+            int trained = match.TrainStrongest();
+            match.LegalMoves(moves);
+            Move m; // stays null when the side has to pass
+            if (!moves.Empty())
+            {
+                if (shared.book.Pick(match.state, random(), m))
+                    totals.bookMoves++;
+                else if (options.depth == 0)
+                    m = moves[random() % moves.Size()];
+                else
+                    m = search.Think(match.state, limits, match.history).best;
+            }
+            match.PlayTurn(m);
+            if (shared.record.is_open())
+                line += " " + TurnToken(trained, m);
+            for (const MatchEvent& e : match.events)
+                if (e.type == MatchEventType::UnitTrained)
+                    totals.unitsTrained++;
+
+            if (options.check && (match.state.hash != match.state.ComputeHash() || !(match.state.eval == match.state.ComputeEval())))
+            {
+                totals.desyncs++;
+                break;
+            }
+            result = match.Result();
+        }
+        if (shared.record.is_open())
+        {
+            std::lock_guard<std::mutex> lock(shared.recordMutex);
+            shared.record << ResultToken(result) << line << "\n";
+        }
+        totals.results[(int)result]++;
+        totals.turns += match.turns;
+    }
+}
+
+// Turns into a random game where the bench positions are taken
+const int BenchTurns[] = { 10, 30, 50, 80, 120, 160 };
+const int BenchDepth = 9;
+const int BenchHashMB = 16;
+
+void BenchSearchThreads(const Options& options, Shared& shared)
+{
+    std::vector<Match> positions;
+    for (int turns : BenchTurns)
+    {
+        std::mt19937_64 random(options.seed + turns);
+        Match match;
+        match.Reset();
+        MoveList moves;
+        while (match.turns < turns && match.Result() == GameResult::Ongoing)
+        {
+            match.TrainStrongest();
+            match.LegalMoves(moves);
+            match.PlayTurn(moves.Empty() ? Move() : moves[random() % moves.Size()]);
+        }
+        if (match.Result() == GameResult::Ongoing)
+            positions.push_back(match);
+    }
+
+    SearchLimits limits;
+    limits.depth = options.depth > 0 ? options.depth : BenchDepth;
+    std::cout << "search bench: " << positions.size() << " positions, depth " << limits.depth << std::endl;
+
+    double baseSeconds = 0;
+    uint64_t baseNps = 0;
+    for (int threads = 1; threads <= options.searchThreads; threads++)
+    {
+        // Every count starts from an empty table so none is helped by the last
+        TranspositionTable table = TranspositionTable(BenchHashMB);
+        Search search = Search(table, threads);
+        search.SetNetwork(&shared.network);
+        search.SetTables(&shared.tables);
+        uint64_t nodes = 0;
+        int hashFull = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const Match& match : positions)
+        {
+            table.Clear();
+            SearchResult result = search.Think(match.state, limits, match.history);
+            nodes += result.nodes;
+            hashFull = std::max(hashFull, result.hashFull);
+        }
+        double seconds = std::max(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 1e-9);
+        uint64_t nps = (uint64_t)(nodes / seconds);
+        if (threads == 1)
+        {
+            baseSeconds = seconds;
+            baseNps = nps;
+        }
+        std::cout << "threads " << threads << " nodes " << nodes << " time " << seconds << "s nps " << nps
+            << std::fixed << std::setprecision(2) << " nps speedup " << (double)nps / std::max(baseNps, (uint64_t)1)
+            << " time speedup " << baseSeconds / seconds << std::defaultfloat << std::setprecision(6) << " hashfull " << hashFull << std::endl;
+    }
+}
+
+// Returns the exit code, 1 on any mismatch
+int CheckNetworkKernels(const Options& options)
+{
+    const Nnue::SimdLevel levels[] = { Nnue::SimdLevel::Scalar, Nnue::SimdLevel::Sse41, Nnue::SimdLevel::Avx2 };
+    std::vector<std::unique_ptr<Nnue::Network>> networks;
+    for (Nnue::SimdLevel level : levels)
+    {
+        // Levels the CPU doesn't have fall back to one already in the list
+        if (level > Nnue::DetectSimd())
+            break;
+        auto network = std::make_unique<Nnue::Network>(level);
+        if (options.net.empty())
+            network->Randomize(options.seed);
+        else if (!network->Load(options.net))
+        {
+            std::cerr << network->error << std::endl;
+            return 2;
+        }
+        networks.push_back(std::move(network));
+    }
+    std::cout << "checking";
+    for (const auto& network : networks)
+        std::cout << " " << Nnue::SimdName(network->Simd());
+    std::cout << " kernels with " << (options.net.empty() ? "random weights" : options.net) << std::endl;
+
+    // Two per network, each turn is updated from the last like the search does from ply to ply
+    std::vector<Nnue::Accumulator> accumulators(networks.size() * 2);
+    uint64_t positions = 0;
+    int mismatches = 0;
+    MoveList moves;
+    for (int game = 0; game < options.games && mismatches == 0; game++)
+    {
+        std::mt19937_64 random(options.seed + game);
+        Match match;
+        match.Reset();
+        for (size_t n = 0; n < networks.size(); n++)
+            networks[n]->Update(match.state, nullptr, accumulators[n * 2]);
+        while (match.turns < options.maxTurns && match.Result() == GameResult::Ongoing)
+        {
+            match.TrainStrongest();
+            match.LegalMoves(moves);
+            match.PlayTurn(moves.Empty() ? Move() : moves[random() % moves.Size()]);
+            positions++;
+
+            int score = 0;
+            int now = match.turns & 1;
+            for (size_t n = 0; n < networks.size(); n++)
+            {
+                Nnue::Accumulator& acc = accumulators[n * 2 + now];
+                networks[n]->Update(match.state, &accumulators[n * 2 + (now ^ 1)], acc);
+                int s = networks[n]->Evaluate(acc, match.state.sideToMove);
+                bool same = networks[n]->Matches(match.state, acc)
+                    && (n == 0 || (s == score && std::memcmp(acc.values, accumulators[now].values, sizeof(acc.values)) == 0));
+                if (n == 0)
+                    score = s;
+                if (!same)
+                {
+                    std::cout << Nnue::SimdName(networks[n]->Simd()) << " differs in game " << game << " turn " << match.turns << std::endl;
+                    mismatches++;
+                }
+            }
+            if (mismatches)
+                break;
+        }
+    }
+    std::cout << "positions " << positions << " mismatches " << mismatches << std::endl;
+    return mismatches ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    Attacks::Init();
+
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--games" && i + 1 < argc)
+            options.games = std::stoi(argv[++i]);
+        else if (arg == "--depth" && i + 1 < argc)
+            options.depth = std::stoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc)
+            options.threads = std::max(std::stoi(argv[++i]), 1);
+        else if (arg == "--max-turns" && i + 1 < argc)
+            options.maxTurns = std::stoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc)
+            options.seed = std::stoull(argv[++i]);
+        else if (arg == "--net" && i + 1 < argc)
+            options.net = argv[++i];
+        else if (arg == "--book" && i + 1 < argc)
+            options.book = argv[++i];
+        else if (arg == "--tables" && i + 1 < argc)
+            options.tables = argv[++i];
+        else if (arg == "--record" && i + 1 < argc)
+            options.record = argv[++i];
+        else if (arg == "--check")
+            options.check = true;
+        else if (arg == "--check-net")
+            options.checkNet = true;
+        else if (arg == "--search-threads" && i + 1 < argc)
+            options.searchThreads = std::max(std::stoi(argv[++i]), 1);
+        else
+        {
+            std::cerr << "usage: SelfPlay [--games <n>] [--depth <d>] [--threads <n>] [--max-turns <n>] [--seed <n>] [--net <file>] [--book <file>] [--tables <dir>] [--record <file>] [--check]" << std::endl;
+            std::cerr << "       SelfPlay --search-threads <n> [--depth <d>] [--seed <n>] [--net <file>] [--tables <dir>]" << std::endl;
+            std::cerr << "       SelfPlay --check-net [--games <n>] [--max-turns <n>] [--seed <n>] [--net <file>]" << std::endl;
+            return 2;
+        }
+    }
+
+    if (options.checkNet)
+        return CheckNetworkKernels(options);
+
+    Shared shared;
+    if (!options.net.empty())
+    {
+        if (!shared.network.Load(options.net))
+        {
+            std::cerr << shared.network.error << std::endl;
+            return 2;
+        }
+        std::cout << "net " << options.net << " (" << Nnue::SimdName(shared.network.Simd()) << ")" << std::endl;
+    }
+    if (!options.book.empty())
+    {
+        if (!shared.book.Open(options.book))
+        {
+            std::cerr << shared.book.error << std::endl;
+            return 2;
+        }
+        std::cout << "book " << options.book << " (" << shared.book.Size() << " entries)" << std::endl;
+    }
+    if (!options.tables.empty())
+    {
+        int count = shared.tables.Open(options.tables);
+        for (const std::string& error : shared.tables.errors)
+            std::cerr << error << std::endl;
+        if (count == 0)
+        {
+            std::cerr << "no endgame tables in " << options.tables << std::endl;
+            return 2;
+        }
+        std::cout << "tables " << options.tables << " (" << count << " up to " << shared.tables.MaxPieces() << " pieces)" << std::endl;
+    }
+    if (!options.record.empty())
+    {
+        shared.record.open(options.record, std::ios::app);
+        if (!shared.record)
+        {
+            std::cerr << "can't open " << options.record << std::endl;
+            return 2;
+        }
+    }
+
+    if (options.searchThreads)
+    {
+        BenchSearchThreads(options, shared);
+        return 0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<int> nextGame = 0;
+    Totals totals;
+    std::vector<std::thread> threads;
+    for (int i = 1; i < options.threads; i++)
+        threads.emplace_back(PlayGames, std::cref(options), std::ref(shared), std::ref(nextGame), std::ref(totals));
+    PlayGames(options, shared, nextGame, totals);
+    for (std::thread& t : threads)
+        t.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "games " << options.games
+        << " white " << totals.results[(int)GameResult::WhiteWins]
+        << " black " << totals.results[(int)GameResult::BlackWins]
+        << " draws " << totals.results[(int)GameResult::Draw]
+        << " unfinished " << totals.results[(int)GameResult::Ongoing] << std::endl;
+    std::cout << "turns " << totals.turns << " time " << seconds << "s games/min " << (uint64_t)(options.games * 60 / std::max(seconds, 1e-9))
+        << " turns/s " << (uint64_t)(totals.turns / std::max(seconds, 1e-9)) << " book moves " << totals.bookMoves
+        << " units trained " << totals.unitsTrained << std::endl;
+    if (totals.desyncs)
+    {
+        std::cout << "desyncs " << totals.desyncs << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,323 @@
+#pragma once
+#include "Bitboard.h"
+#include <cstring>
+#include <array>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define ATTACKS_HAS_PEXT 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#define ATTACKS_TARGET_BMI2
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define ATTACKS_TARGET_BMI2 __attribute__((target("bmi2")))
+#endif
+#else
+#define ATTACKS_HAS_PEXT 0
+#endif
+
+// Precomputed attack tables. Sliding pieces use magic bitboards, or PEXT when
+// the CPU has a fast BMI2 implementation, so a rook, bishop or queen gets all
+// of its attacked squares from one table lookup. Call Attacks::Init() once
+// before using the sliding lookups, the leaper tables are built at compile time.
+namespace Attacks {
+
+    typedef std::array<Bitboard, 64> Table;
+
+    // Squares reached by stepping once by each offset, anything off the board is dropped here
+    constexpr Table LeaperTable(const int offsets[][2], int count)
+    {
+        Table table = {};
+        for (int sq = 0; sq < 64; sq++)
+            for (int i = 0; i < count; i++)
+            {
+                int x = SquareX(sq) + offsets[i][0];
+                int y = SquareY(sq) + offsets[i][1];
+                if (OnBoard(x, y))
+                    table[sq] |= SquareBit(SquareOf(x, y));
+            }
+        return table;
+    }
+
+    constexpr int KnightOffsets[8][2] = { { 1, 2 }, { 2, 1 }, { 2, -1 }, { 1, -2 }, { -1, -2 }, { -2, -1 }, { -2, 1 }, { -1, 2 } };
+    constexpr int KingOffsets[8][2] = { { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 } };
+    constexpr int WhitePawnCaptures[2][2] = { { -1, 1 }, { 1, 1 } };
+    constexpr int BlackPawnCaptures[2][2] = { { -1, -1 }, { 1, -1 } };
+    constexpr int WhitePawnPush[1][2] = { { 0, 1 } };
+    constexpr int BlackPawnPush[1][2] = { { 0, -1 } };
+
+    // White pawns move up the board from y = 2, black pawns down from y = 7
+    constexpr Table PawnDoublePushTable(int side)
+    {
+        Table table = {};
+        for (int x = 1; x <= 8; x++)
+        {
+            if (side == White)
+                table[SquareOf(x, 2)] = SquareBit(SquareOf(x, 4));
+            else
+                table[SquareOf(x, 7)] = SquareBit(SquareOf(x, 5));
+        }
+        return table;
+    }
+
+    constexpr Table KnightAttacks = LeaperTable(KnightOffsets, 8);
+    constexpr Table KingAttacks = LeaperTable(KingOffsets, 8);
+    constexpr Table PawnAttacks[2] = { LeaperTable(WhitePawnCaptures, 2), LeaperTable(BlackPawnCaptures, 2) };
+    constexpr Table PawnPushes[2] = { LeaperTable(WhitePawnPush, 1), LeaperTable(BlackPawnPush, 1) };
+    constexpr Table PawnDoublePushes[2] = { PawnDoublePushTable(White), PawnDoublePushTable(Black) };
+
+    static_assert(KnightAttacks[0] == (SquareBit(10) | SquareBit(17)), "knight table is wrong");
+    static_assert(KingAttacks[63] == (SquareBit(54) | SquareBit(55) | SquareBit(62)), "king table is wrong");
+    static_assert(PawnAttacks[White][8] == SquareBit(17) && PawnAttacks[Black][55] == SquareBit(46), "pawn table is wrong");
+
+    struct Magic {
+        Bitboard mask; // relevant blocker squares, the board edges are left out
+        Bitboard magic;
+        Bitboard* attacks; // this square's slice of the shared table
+        unsigned shift;
+    };
+
+    inline Magic rookMagics[64];
+    inline Magic bishopMagics[64];
+
+    // Sizes are the sum of 2^(relevant bits) over every square
+    inline Bitboard rookTable[0x19000];
+    inline Bitboard bishopTable[0x1480];
+
+    // Squares strictly between two squares on a rank, file or diagonal, and the
+    // whole line through them, empty when the squares aren't aligned
+    inline Bitboard betweenTable[64][64];
+    inline Bitboard lineTable[64][64];
+
+    inline bool usePext = false;
+    inline bool initialised = false;
+
+    const int RookDirections[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+    const int BishopDirections[4][2] = { { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+
+#if ATTACKS_HAS_PEXT
+    ATTACKS_TARGET_BMI2 inline unsigned PextIndex(Bitboard occupied, Bitboard mask)
+    {
+        return (unsigned)_pext_u64(occupied, mask);
+    }
+
+    // BMI2 is only worth it where PEXT is done in hardware, AMD before Zen 3 microcodes it
+    inline bool CpuHasFastPext()
+    {
+        unsigned regs[4] = {};
+        char vendor[13] = {};
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        for (int i = 0; i < 4; i++)
+            regs[i] = (unsigned)info[i];
+#else
+        __cpuid(0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        unsigned maxLeaf = regs[0];
+        std::memcpy(vendor, &regs[1], 4);
+        std::memcpy(vendor + 4, &regs[3], 4);
+        std::memcpy(vendor + 8, &regs[2], 4);
+        if (maxLeaf < 7)
+            return false;
+
+#if defined(_MSC_VER)
+        __cpuidex(info, 7, 0);
+        bool bmi2 = info[1] & (1 << 8);
+        __cpuid(info, 1);
+        unsigned signature = (unsigned)info[0];
+#else
+        __cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+        bool bmi2 = regs[1] & (1 << 8);
+        __cpuid(1, regs[0], regs[1], regs[2], regs[3]);
+        unsigned signature = regs[0];
+#endif
+        if (!bmi2)
+            return false;
+
+        unsigned family = ((signature >> 8) & 0xF) + ((signature >> 20) & 0xFF);
+        bool isAmd = std::strcmp(vendor, "AuthenticAMD") == 0;
+        return !(isAmd && family < 0x19);
+    }
+#endif
+
+    inline unsigned TableIndex(const Magic& m, Bitboard occupied)
+    {
+#if ATTACKS_HAS_PEXT
+        if (usePext)
+            return PextIndex(occupied, m.mask);
+#endif
+        return (unsigned)(((occupied & m.mask) * m.magic) >> m.shift);
+    }
+
+    // Walks the rays one square at a time, only used while building the tables
+    inline Bitboard SlidingAttacksSlow(int sq, Bitboard occupied, const int directions[4][2])
+    {
+        Bitboard attacks = 0;
+        for (int d = 0; d < 4; d++)
+        {
+            int x = SquareX(sq) + directions[d][0];
+            int y = SquareY(sq) + directions[d][1];
+            while (OnBoard(x, y))
+            {
+                Bitboard b = SquareBit(SquareOf(x, y));
+                attacks |= b;
+                if (occupied & b)
+                    break;
+                x += directions[d][0];
+                y += directions[d][1];
+            }
+        }
+        return attacks;
+    }
+
+    inline Bitboard RelevantMask(int sq, const int directions[4][2])
+    {
+        Bitboard mask = 0;
+        for (int d = 0; d < 4; d++)
+        {
+            int x = SquareX(sq) + directions[d][0];
+            int y = SquareY(sq) + directions[d][1];
+            // The last square on a ray never blocks anything behind it
+            while (OnBoard(x + directions[d][0], y + directions[d][1]))
+            {
+                mask |= SquareBit(SquareOf(x, y));
+                x += directions[d][0];
+                y += directions[d][1];
+            }
+        }
+        return mask;
+    }
+
+    // Finds a magic for every square by trial from fixed seeds, so the tables
+    // are the same on every run.
+    inline void InitSliders(Magic magics[64], Bitboard* table, const int directions[4][2])
+    {
+        Bitboard occupancy[4096];
+        Bitboard reference[4096];
+        int epoch[4096] = {};
+        int attempt = 0;
+        uint64_t seed = 0;
+
+        // Per-rank seeds known to find magics after few attempts
+        const uint64_t rankSeeds[8] = { 728, 10316, 55013, 32803, 12281, 15100, 16645, 255 };
+
+        auto random = [&seed]() {
+            seed ^= seed >> 12;
+            seed ^= seed << 25;
+            seed ^= seed >> 27;
+            return seed * 2685821657736338717ull;
+        };
+
+        Bitboard* next = table;
+        for (int sq = 0; sq < 64; sq++)
+        {
+            Magic& m = magics[sq];
+            m.mask = RelevantMask(sq, directions);
+            m.shift = 64 - PopCount(m.mask);
+            m.attacks = next;
+
+            // Enumerate every subset of the mask (Carry-Rippler)
+            int size = 0;
+            Bitboard subset = 0;
+            do {
+                occupancy[size] = subset;
+                reference[size] = SlidingAttacksSlow(sq, subset, directions);
+                size++;
+                subset = (subset - m.mask) & m.mask;
+            } while (subset);
+            next += size;
+
+            seed = rankSeeds[sq >> 3];
+
+            if (usePext)
+            {
+                m.magic = 0;
+                for (int i = 0; i < size; i++)
+                    m.attacks[TableIndex(m, occupancy[i])] = reference[i];
+                continue;
+            }
+
+            for (int i = 0; i < size;)
+            {
+                do {
+                    m.magic = random() & random() & random();
+                } while (PopCount((m.mask * m.magic) >> 56) < 6);
+
+                // A collision is fine as long as both occupancies give the same attacks
+                attempt++;
+                for (i = 0; i < size; i++)
+                {
+                    unsigned idx = TableIndex(m, occupancy[i]);
+                    if (epoch[idx] < attempt)
+                    {
+                        epoch[idx] = attempt;
+                        m.attacks[idx] = reference[i];
+                    }
+                    else if (m.attacks[idx] != reference[i])
+                        break;
+                }
+            }
+        }
+    }
+
+    inline void InitLines()
+    {
+        for (int a = 0; a < 64; a++)
+            for (int b = 0; b < 64; b++)
+            {
+                betweenTable[a][b] = 0;
+                lineTable[a][b] = 0;
+                for (const auto* directions : { RookDirections, BishopDirections })
+                {
+                    Bitboard fromA = SlidingAttacksSlow(a, 0, directions);
+                    if (a == b || !(fromA & SquareBit(b)))
+                        continue;
+                    betweenTable[a][b] = SlidingAttacksSlow(a, SquareBit(b), directions) & SlidingAttacksSlow(b, SquareBit(a), directions);
+                    lineTable[a][b] = (fromA & SlidingAttacksSlow(b, 0, directions)) | SquareBit(a) | SquareBit(b);
+                }
+            }
+    }
+
+    inline void Init()
+    {
+        if (initialised)
+            return;
+#if ATTACKS_HAS_PEXT
+        usePext = CpuHasFastPext();
+#endif
+        InitSliders(rookMagics, rookTable, RookDirections);
+        InitSliders(bishopMagics, bishopTable, BishopDirections);
+        InitLines();
+        initialised = true;
+    }
+
+    inline Bitboard Rook(int sq, Bitboard occupied)
+    {
+        const Magic& m = rookMagics[sq];
+        return m.attacks[TableIndex(m, occupied)];
+    }
+
+    inline Bitboard Bishop(int sq, Bitboard occupied)
+    {
+        const Magic& m = bishopMagics[sq];
+        return m.attacks[TableIndex(m, occupied)];
+    }
+
+    inline Bitboard Queen(int sq, Bitboard occupied)
+    {
+        return Rook(sq, occupied) | Bishop(sq, occupied);
+    }
+
+    inline Bitboard Between(int a, int b)
+    {
+        return betweenTable[a][b];
+    }
+
+    inline Bitboard Line(int a, int b)
+    {
+        return lineTable[a][b];
+    }
+}
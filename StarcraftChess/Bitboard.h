@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <bit>
+
+// Core board types shared by the game, the AI and the tools. Nothing in here
+// depends on raylib so it can be used without a window.
+
+typedef uint64_t Bitboard;
+
+enum class PieceType : uint8_t {
+    Pawn = 0,
+    Rook = 1,
+    Knight = 2,
+    Bishop = 3,
+    Queen = 4,
+    King = 5
+};
+
+const int PieceTypeCount = 6;
+
+enum Side {
+    White = 0,
+    Black = 1
+};
+
+const int NoSquare = -1;
+
+// Squares are 0..63, a square is (y - 1) * 8 + (x - 1) of the 1..8 grid the game uses.
+constexpr int SquareOf(int gridX, int gridY)
+{
+    return (gridY - 1) * 8 + (gridX - 1);
+}
+
+constexpr int SquareX(int sq)
+{
+    return (sq & 7) + 1;
+}
+
+constexpr int SquareY(int sq)
+{
+    return (sq >> 3) + 1;
+}
+
+constexpr bool OnBoard(int gridX, int gridY)
+{
+    return gridX >= 1 && gridX <= 8 && gridY >= 1 && gridY <= 8;
+}
+
+constexpr Bitboard SquareBit(int sq)
+{
+    return Bitboard(1) << sq;
+}
+
+inline int PopCount(Bitboard b)
+{
+    return std::popcount(b);
+}
+
+// Index of the lowest set bit, b must not be empty
+inline int LowestSquare(Bitboard b)
+{
+    return std::countr_zero(b);
+}
+
+// Removes the lowest set bit and returns its index
+inline int PopLowest(Bitboard& b)
+{
+    int sq = std::countr_zero(b);
+    b &= b - 1;
+    return sq;
+}
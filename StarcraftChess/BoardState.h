@@ -0,0 +1,96 @@
+#pragma once
+#include "Bitboard.h"
+
+// Occupancy of the board stored as one bitboard per side and per piece type,
+// plus the variant's mineral field and trained unit layers. Every query is a
+// couple of bit operations instead of a scan over the pieces.
+struct BoardState {
+    Bitboard sides[2] = {};
+    Bitboard types[PieceTypeCount] = {};
+    Bitboard minerals = 0; // squares holding a mineral field
+    Bitboard units = 0; // pieces that were trained during the game rather than set up
+
+    void Clear()
+    {
+        *this = BoardState();
+    }
+
+    Bitboard Occupied() const
+    {
+        return sides[White] | sides[Black];
+    }
+
+    Bitboard Pieces(int side) const
+    {
+        return sides[side];
+    }
+
+    Bitboard Pieces(PieceType t) const
+    {
+        return types[(int)t];
+    }
+
+    Bitboard Pieces(int side, PieceType t) const
+    {
+        return sides[side] & types[(int)t];
+    }
+
+    bool IsOccupied(int sq) const
+    {
+        return Occupied() & SquareBit(sq);
+    }
+
+    bool IsSide(int sq, int side) const
+    {
+        return sides[side] & SquareBit(sq);
+    }
+
+    // Side of the piece on a square, or -1 if the square is empty
+    int SideAt(int sq) const
+    {
+        if (sides[White] & SquareBit(sq))
+            return White;
+        if (sides[Black] & SquareBit(sq))
+            return Black;
+        return -1;
+    }
+
+    // Type of the piece on a square, the square must be occupied
+    PieceType TypeAt(int sq) const
+    {
+        Bitboard b = SquareBit(sq);
+        for (int t = 0; t < PieceTypeCount; t++)
+            if (types[t] & b)
+                return (PieceType)t;
+        return PieceType::King;
+    }
+
+    void AddPiece(int sq, PieceType t, int side, bool trained = false)
+    {
+        Bitboard b = SquareBit(sq);
+        sides[side] |= b;
+        types[(int)t] |= b;
+        if (trained)
+            units |= b;
+    }
+
+    void RemovePiece(int sq)
+    {
+        Bitboard b = ~SquareBit(sq);
+        sides[White] &= b;
+        sides[Black] &= b;
+        for (Bitboard& t : types)
+            t &= b;
+        units &= b;
+    }
+
+    void MovePiece(int from, int to)
+    {
+        Bitboard fromTo = SquareBit(from) | SquareBit(to);
+        int side = SideAt(from);
+        sides[side] ^= fromTo;
+        types[(int)TypeAt(from)] ^= fromTo;
+        if (units & SquareBit(from))
+            units ^= fromTo;
+    }
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include <algorithm>
+#include "Bitboard.h"
+
+// Mineral nodes and harvesting. Every piece standing on a node's square or
+// next to it works that node, and at the end of each of its side's turns
+// (the economy's tick) every worker brings in the node's yield until the node
+// runs dry. The nodes are kept as parallel arrays so a tick is one short loop
+// over plain integers, and each side's income is a running total that only
+// changes when a worker comes or goes or a node runs low, so nothing is
+// recounted per turn. GameState owns one and keeps it in step with the board,
+// the same code runs on screen, headless and inside the search.
+
+const int MaxMineralNodes = 8;
+const int MineralWorkerCap = 3; // workers past this on one node add nothing
+
+class MineralNodes {
+public:
+    int count = 0;
+    int8_t square[MaxMineralNodes] = {};
+    Bitboard area[MaxMineralNodes] = {}; // squares whose pieces work the node
+    int32_t remaining[MaxMineralNodes] = {};
+    int16_t yield[MaxMineralNodes] = {}; // per worker per tick
+    uint8_t workers[2][MaxMineralNodes] = {};
+    int income[2] = {}; // what each side's next tick brings in
+    Bitboard areas = 0; // every node's area, pieces elsewhere don't touch the economy
+
+    // Adds a node with no workers, false when there's no room left
+    bool Add(int sq, int amount, int perWorker)
+    {
+        if (count >= MaxMineralNodes)
+            return false;
+        int n = count++;
+        square[n] = (int8_t)sq;
+        area[n] = Neighbourhood(sq);
+        remaining[n] = amount;
+        yield[n] = (int16_t)perWorker;
+        workers[White][n] = workers[Black][n] = 0;
+        areas |= area[n];
+        return true;
+    }
+
+    int Harvest(int side, int n) const
+    {
+        return std::min(std::min<int>(workers[side][n], MineralWorkerCap) * yield[n], remaining[n]);
+    }
+
+    // A piece of side arrived on sq (+1) or left it (-1)
+    void MoveWorker(int side, int sq, int delta)
+    {
+        for (int n = 0; n < count; n++)
+        {
+            if (!(area[n] & SquareBit(sq)))
+                continue;
+            income[side] -= Harvest(side, n);
+            workers[side][n] += delta;
+            income[side] += Harvest(side, n);
+        }
+    }
+
+    // One tick for side: takes every node's harvest, writes what came out of
+    // each into taken for Restore and returns the total
+    int Tick(int side, int16_t* taken)
+    {
+        int total = 0;
+        for (int n = 0; n < count; n++)
+        {
+            int amount = Harvest(side, n);
+            taken[n] = (int16_t)amount;
+            if (amount == 0)
+                continue;
+            SetRemaining(n, remaining[n] - amount);
+            total += amount;
+        }
+        return total;
+    }
+
+    // Puts back what a Tick took
+    void Restore(const int16_t* taken)
+    {
+        for (int n = 0; n < count; n++)
+            if (taken[n])
+                SetRemaining(n, remaining[n] + taken[n]);
+    }
+
+    // Income recounted from a board's pieces, for checking the running totals
+    int CountIncome(Bitboard pieces) const
+    {
+        int total = 0;
+        for (int n = 0; n < count; n++)
+            total += std::min(std::min(PopCount(pieces & area[n]), MineralWorkerCap) * yield[n], remaining[n]);
+        return total;
+    }
+
+    static Bitboard Neighbourhood(int sq)
+    {
+        Bitboard b = 0;
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++)
+                if (OnBoard(SquareX(sq) + dx, SquareY(sq) + dy))
+                    b |= SquareBit(SquareOf(SquareX(sq) + dx, SquareY(sq) + dy));
+        return b;
+    }
+
+private:
+    // A node nearly dry caps what both sides get from it
+    void SetRemaining(int n, int amount)
+    {
+        for (int side = White; side <= Black; side++)
+            income[side] -= Harvest(side, n);
+        remaining[n] = amount;
+        for (int side = White; side <= Black; side++)
+            income[side] += Harvest(side, n);
+    }
+};
@@ -0,0 +1,521 @@
+#pragma once
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "Match.h"
+
+// Endgame tables: win/draw/loss and distance for every position of a small
+// material set, built ahead of time by retrograde analysis (see TableGen) so
+// the search can look them up instead of searching the same endings again.
+//
+// The tables follow the variant's own ending rules: there are no kings, a
+// side left with no pieces has lost, and a side with nothing to move passes
+// the turn. They don't follow the economy. The search only probes when both
+// queues are empty and neither side could pay for a unit before the table's
+// result is reached, and never for a draw, which income always breaks in the
+// end. En passant after a double push isn't followed either, and positions
+// with an en passant square aren't probed.
+//
+// A value is one byte from the side to move's point of view: 0 a draw,
+// 1..126 a win in that many turns, 128 + d a loss in d turns.
+namespace Endgame {
+    const uint8_t Draw = 0;
+    const uint8_t LossBase = 128;
+    const uint8_t Invalid = 255; // only while generating, never stored
+    const int MaxDistance = 126;
+    const int MaxPieces = 4;
+
+    inline bool IsWin(uint8_t v)
+    {
+        return v > 0 && v < LossBase;
+    }
+
+    inline bool IsLoss(uint8_t v)
+    {
+        return v >= LossBase && v != Invalid;
+    }
+
+    inline int Distance(uint8_t v)
+    {
+        return IsLoss(v) ? v - LossBase : v;
+    }
+
+    // Material is a count per side for each type but the king, 4 bits each
+    typedef uint64_t MaterialKey;
+
+    // Types in the order tables list them
+    const PieceType MaterialOrder[5] = { PieceType::Queen, PieceType::Rook, PieceType::Bishop, PieceType::Knight, PieceType::Pawn };
+
+    inline int MaterialCount(MaterialKey key, int side, PieceType t)
+    {
+        return (int)(key >> ((side * 5 + (int)t) * 4)) & 15;
+    }
+
+    inline MaterialKey MaterialOf(const BoardState& board)
+    {
+        MaterialKey key = 0;
+        for (int side = White; side <= Black; side++)
+            for (PieceType t : MaterialOrder)
+                key |= (MaterialKey)std::min(PopCount(board.Pieces(side, t)), 15) << ((side * 5 + (int)t) * 4);
+        return key;
+    }
+
+    inline MaterialKey FlipMaterial(MaterialKey key)
+    {
+        return (key >> 20) | ((key & 0xFFFFF) << 20);
+    }
+
+    inline int MaterialPieces(MaterialKey key, int side)
+    {
+        int n = 0;
+        for (PieceType t : MaterialOrder)
+            n += MaterialCount(key, side, t);
+        return n;
+    }
+
+    inline int MaterialPieces(MaterialKey key)
+    {
+        return MaterialPieces(key, White) + MaterialPieces(key, Black);
+    }
+
+    inline int MaterialValue(MaterialKey key, int side)
+    {
+        int value = 0;
+        for (PieceType t : MaterialOrder)
+            value += MaterialCount(key, side, t) * PieceValues[(int)t];
+        return value;
+    }
+
+    // Tables are kept with the stronger side as white, the other way round is
+    // looked up with the colours swapped
+    inline bool IsCanonical(MaterialKey key)
+    {
+        int white = MaterialValue(key, White);
+        int black = MaterialValue(key, Black);
+        return white != black ? white > black : (key & 0xFFFFF) >= (key >> 20);
+    }
+
+    inline MaterialKey Canonical(MaterialKey key)
+    {
+        return IsCanonical(key) ? key : FlipMaterial(key);
+    }
+
+    // "QvRP" style names, also the file names
+    inline std::string MaterialName(MaterialKey key)
+    {
+        std::string name;
+        for (int side = White; side <= Black; side++)
+        {
+            if (side == Black)
+                name += 'v';
+            for (PieceType t : MaterialOrder)
+                name.append(MaterialCount(key, side, t), "PRNBQK"[(int)t]);
+        }
+        return name;
+    }
+
+    // Both sides need a piece, a side without one has already lost
+    inline bool ParseMaterialName(const std::string& name, MaterialKey& key)
+    {
+        key = 0;
+        size_t v = name.find('v');
+        if (v == std::string::npos || v == 0 || v + 1 >= name.size())
+            return false;
+        for (size_t i = 0; i < name.size(); i++)
+        {
+            if (i == v)
+                continue;
+            const char* letters = "PRNBQ";
+            const char* letter = std::strchr(letters, name[i]);
+            if (!letter || !*letter)
+                return false;
+            int side = i < v ? White : Black;
+            int shift = (side * 5 + (int)(letter - letters)) * 4;
+            if (((key >> shift) & 15) == 15)
+                return false;
+            key += (MaterialKey)1 << shift;
+        }
+        return true;
+    }
+
+    // Board symmetries, a table only holds positions with white's first piece
+    // in one corner region: a triangle of 10 squares without pawns, the a-d
+    // files with them since pawns can't be turned
+    inline int MirrorFile(int sq) { return sq ^ 7; }
+    inline int MirrorRank(int sq) { return sq ^ 56; }
+    inline int Transpose(int sq) { return ((sq & 7) << 3) | (sq >> 3); }
+
+    struct Symmetry {
+        bool mirrorFile = false;
+        bool mirrorRank = false;
+        bool transpose = false;
+
+        int Apply(int sq) const
+        {
+            if (mirrorFile)
+                sq = MirrorFile(sq);
+            if (mirrorRank)
+                sq = MirrorRank(sq);
+            if (transpose)
+                sq = Transpose(sq);
+            return sq;
+        }
+    };
+
+    inline Symmetry SymmetryFor(int anchor, bool pawns)
+    {
+        Symmetry s;
+        s.mirrorFile = (anchor & 7) >= 4;
+        if (pawns)
+            return s;
+        int sq = s.Apply(anchor);
+        s.mirrorRank = (sq >> 3) >= 4;
+        sq = s.Apply(anchor);
+        s.transpose = (sq >> 3) > (sq & 7);
+        return s;
+    }
+
+    // Position of a square in the anchor's region, -1 outside it
+    inline int AnchorRegionIndex(int sq, bool pawns)
+    {
+        int x = sq & 7, y = sq >> 3;
+        if (pawns)
+            return x < 4 ? y * 4 + x : -1;
+        static const int Triangle[4][4] = { { 0, 1, 2, 3 }, { -1, 4, 5, 6 }, { -1, -1, 7, 8 }, { -1, -1, -1, 9 } };
+        return x < 4 && y < 4 ? Triangle[y][x] : -1;
+    }
+
+    inline int AnchorRegionSquare(int index, bool pawns)
+    {
+        for (int sq = 0; sq < 64; sq++)
+            if (AnchorRegionIndex(sq, pawns) == index)
+                return sq;
+        return NoSquare;
+    }
+
+    // Maps the positions of one canonical material set to table indices and
+    // back. Squares are listed white's pieces then black's, each in
+    // MaterialOrder; the first one is the anchor the symmetries are taken from.
+    class Indexer {
+    public:
+        MaterialKey key = 0;
+        int count = 0;
+        int sides[MaxPieces] = {};
+        PieceType types[MaxPieces] = {};
+        bool pawns = false;
+        uint64_t size = 0;
+
+        explicit Indexer(MaterialKey material = 0) : key(material)
+        {
+            for (int side = White; side <= Black; side++)
+                for (PieceType t : MaterialOrder)
+                    for (int i = 0; i < MaterialCount(key, side, t) && count < MaxPieces; i++)
+                    {
+                        sides[count] = side;
+                        types[count++] = t;
+                        pawns |= t == PieceType::Pawn;
+                    }
+            size = (uint64_t)(pawns ? 32 : 10) * 2;
+            for (int i = 1; i < count; i++)
+                size *= 64;
+        }
+
+        uint64_t Index(const int* squares, int sideToMove) const
+        {
+            Symmetry s = SymmetryFor(squares[0], pawns);
+            uint64_t index = AnchorRegionIndex(s.Apply(squares[0]), pawns);
+            for (int i = 1; i < count; i++)
+                index = index * 64 + s.Apply(squares[i]);
+            return index * 2 + sideToMove;
+        }
+
+        // Index of a state whose material is key, or key with the colours swapped when flip is set
+        uint64_t Index(const GameState& state, bool flip) const
+        {
+            int squares[MaxPieces];
+            int n = 0;
+            for (int i = 0; i < count; i++)
+            {
+                // Pieces of one type come in a row, so each takes the next square of its bitboard
+                if (i > 0 && sides[i] == sides[i - 1] && types[i] == types[i - 1])
+                    continue;
+                Bitboard b = state.board.Pieces(sides[i] ^ (int)flip, types[i]);
+                while (b && n < MaxPieces)
+                {
+                    int sq = PopLowest(b);
+                    squares[n++] = flip ? MirrorRank(sq) : sq;
+                }
+            }
+            return Index(squares, state.sideToMove ^ (int)flip);
+        }
+
+        // Squares of an index, false when two pieces share a square
+        bool Decode(uint64_t index, int* squares, int& sideToMove) const
+        {
+            sideToMove = (int)(index & 1);
+            index >>= 1;
+            for (int i = count - 1; i >= 1; i--)
+            {
+                squares[i] = (int)(index & 63);
+                index >>= 6;
+            }
+            squares[0] = AnchorRegionSquare((int)index, pawns);
+            Bitboard seen = 0;
+            for (int i = 0; i < count; i++)
+            {
+                if (seen & SquareBit(squares[i]))
+                    return false;
+                seen |= SquareBit(squares[i]);
+            }
+            return true;
+        }
+    };
+
+    // File layout, little-endian: the header, blockCount + 1 offsets into the
+    // data, then the data. Values are cut into blocks stored on their own, so
+    // a probe only reads the block it needs. A block is run-length encoded as
+    // (length, value) byte pairs when that comes out smaller, otherwise it's
+    // one byte per value; a block as long as its values is always raw.
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        char name[16];
+        uint64_t entries;
+        uint32_t blockSize;
+        uint32_t blockCount;
+    };
+    static_assert(sizeof(FileHeader) == 40, "the table header is 40 bytes on disk");
+
+    const char Magic[4] = { 'S', 'C', 'T', 'B' };
+    const uint32_t FileVersion = 3; // 1 had kings, 2 encoded every block
+    const uint32_t BlockSize = 8192;
+    const char* const FileExtension = ".sctb";
+
+    // Compresses and writes a finished table. Invalid entries can be anything
+    // and take the value before them so they extend its run.
+    inline bool WriteTable(const std::string& path, MaterialKey key, const std::vector<uint8_t>& values)
+    {
+        uint32_t blockCount = (uint32_t)((values.size() + BlockSize - 1) / BlockSize);
+        std::vector<uint64_t> offsets;
+        std::vector<uint8_t> data;
+        std::vector<uint8_t> raw;
+        std::vector<uint8_t> runs;
+        uint8_t last = Draw;
+        for (uint32_t block = 0; block < blockCount; block++)
+        {
+            offsets.push_back(data.size());
+            size_t end = std::min(values.size(), (size_t)(block + 1) * BlockSize);
+            raw.clear();
+            for (size_t i = (size_t)block * BlockSize; i < end; i++)
+                raw.push_back(last = values[i] == Invalid ? last : values[i]);
+            runs.clear();
+            for (size_t i = 0; i < raw.size() && runs.size() < raw.size();)
+            {
+                size_t run = 0;
+                while (i + run < raw.size() && run < 255 && raw[i + run] == raw[i])
+                    run++;
+                runs.push_back((uint8_t)run);
+                runs.push_back(raw[i]);
+                i += run;
+            }
+            const std::vector<uint8_t>& stored = runs.size() < raw.size() ? runs : raw;
+            data.insert(data.end(), stored.begin(), stored.end());
+        }
+        offsets.push_back(data.size());
+
+        FILE* out = std::fopen(path.c_str(), "wb");
+        if (!out)
+            return false;
+        FileHeader header = {};
+        std::memcpy(header.magic, Magic, 4);
+        header.version = FileVersion;
+        std::string name = MaterialName(key);
+        std::memcpy(header.name, name.c_str(), std::min(name.size(), sizeof(header.name) - 1));
+        header.entries = values.size();
+        header.blockSize = BlockSize;
+        header.blockCount = blockCount;
+        bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1
+            && std::fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), out) == offsets.size()
+            && std::fwrite(data.data(), 1, data.size(), out) == data.size();
+        return std::fclose(out) == 0 && ok;
+    }
+
+    // One memory-mapped table file
+    class Table {
+    public:
+        Indexer indexer;
+
+        bool Open(const std::string& path, std::string& error)
+        {
+            if (!file.Open(path))
+            {
+                error = "can't open " + path;
+                return false;
+            }
+            if (Check(path, error))
+                return true;
+            file.Close();
+            return false;
+        }
+
+        uint8_t Value(uint64_t index) const
+        {
+            uint64_t block = index / blockSize;
+            uint64_t skip = index % blockSize;
+            const uint8_t* p = data + offsets[block];
+            const uint8_t* end = data + offsets[block + 1];
+            if ((uint64_t)(end - p) == std::min<uint64_t>(blockSize, entries - block * blockSize))
+                return p[skip];
+            for (; p < end; p += 2)
+            {
+                if (skip < p[0])
+                    return p[1];
+                skip -= p[0];
+            }
+            return Draw;
+        }
+
+    private:
+        MappedFile file;
+        const uint64_t* offsets = nullptr;
+        const uint8_t* data = nullptr;
+        uint32_t blockSize = BlockSize;
+        uint64_t entries = 0;
+
+        // Reads the header and checks the file is whole, nothing else is touched
+        bool Check(const std::string& path, std::string& error)
+        {
+            FileHeader header;
+            MaterialKey key;
+            if (file.Size() < sizeof(header))
+            {
+                error = path + " isn't a table file";
+                return false;
+            }
+            std::memcpy(&header, file.Data(), sizeof(header));
+            header.name[sizeof(header.name) - 1] = 0;
+            if (std::memcmp(header.magic, Magic, 4) != 0 || !ParseMaterialName(header.name, key))
+            {
+                error = path + " isn't a table file";
+                return false;
+            }
+            if (header.version != FileVersion)
+            {
+                error = path + " is version " + std::to_string(header.version) + ", expected " + std::to_string(FileVersion);
+                return false;
+            }
+            indexer = Indexer(key);
+            size_t dataStart = sizeof(header) + ((size_t)header.blockCount + 1) * sizeof(uint64_t);
+            if (header.entries != indexer.size || header.blockSize == 0 || file.Size() < dataStart
+                || header.blockCount != (header.entries + header.blockSize - 1) / header.blockSize)
+            {
+                error = path + " doesn't match its material";
+                return false;
+            }
+            offsets = (const uint64_t*)(file.Data() + sizeof(header));
+            data = file.Data() + dataStart;
+            blockSize = header.blockSize;
+            entries = header.entries;
+            if (offsets[header.blockCount] != file.Size() - dataStart)
+            {
+                error = path + " is cut short";
+                return false;
+            }
+            return true;
+        }
+    };
+
+    // What a probe found, from the side to move's point of view
+    struct ProbeResult {
+        int wdl = 0; // 1 win, 0 draw, -1 loss
+        int distance = 0; // turns to the end with best play
+    };
+
+    // Every table in a directory, looked up by material
+    class Tables {
+    public:
+        std::vector<std::string> errors; // files that were skipped on Open
+
+        // Maps every table file in the directory, returns how many there were
+        int Open(const std::string& directory)
+        {
+            tables.clear();
+            errors.clear();
+            maxPieces = 0;
+            std::error_code ec;
+            for (const auto& entry : std::filesystem::directory_iterator(directory, ec))
+            {
+                if (entry.path().extension() != FileExtension)
+                    continue;
+                auto table = std::make_unique<Table>();
+                std::string error;
+                if (!table->Open(entry.path().string(), error))
+                {
+                    errors.push_back(error);
+                    continue;
+                }
+                maxPieces = std::max(maxPieces, table->indexer.count);
+                MaterialKey key = table->indexer.key;
+                tables[key] = std::move(table);
+            }
+            return (int)tables.size();
+        }
+
+        int MaxPieces() const
+        {
+            return maxPieces;
+        }
+
+        // False when there's no table for the position or the economy could
+        // change its result: a draw, or a win or loss at least as far off as
+        // either side's first chance to pay for a unit
+        bool Probe(const GameState& state, ProbeResult& result) const
+        {
+            const BoardState& board = state.board;
+            if (PopCount(board.Occupied()) > maxPieces || state.epSquare != NoSquare
+                || state.trainingCount[White] || state.trainingCount[Black])
+                return false;
+
+            MaterialKey key = MaterialOf(board);
+            bool flip = !IsCanonical(key);
+            auto it = tables.find(flip ? FlipMaterial(key) : key);
+            if (it == tables.end())
+                return false;
+            const Table& table = *it->second;
+            uint8_t v = table.Value(table.indexer.Index(state, flip));
+            if (v == Draw)
+                return false;
+            result.wdl = IsWin(v) ? 1 : -1;
+            result.distance = Distance(v);
+            if (std::min(TurnsUntilTraining(state, White), TurnsUntilTraining(state, Black)) < result.distance)
+                return false;
+            return true;
+        }
+
+        // Turns from now until side could first queue a unit, if every turn
+        // brought in all the income it could
+        static int TurnsUntilTraining(const GameState& state, int side)
+        {
+            int cheapest = INT32_MAX;
+            for (int cost : TrainingCosts)
+                if (cost > 0)
+                    cheapest = std::min(cheapest, cost);
+            int income = TurnIncome;
+            for (int n = 0; n < state.mining.count; n++)
+                income += std::min<int>(MineralWorkerCap * state.mining.yield[n], state.mining.remaining[n]);
+            int missing = cheapest - state.minerals[side];
+            int ownTurns = missing <= 0 ? 0 : (missing + income - 1) / income;
+            return ownTurns * 2 + (side != state.sideToMove);
+        }
+
+    private:
+        std::map<MaterialKey, std::unique_ptr<Table>> tables;
+        int maxPieces = 0;
+    };
+}
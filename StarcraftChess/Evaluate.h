@@ -0,0 +1,36 @@
+#pragma once
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include "GameState.h"
+
+// Debug builds check the incrementally kept terms against a full recompute on
+// every call, define EVAL_CHECK to do the same in a release build
+#if defined(_DEBUG) && !defined(EVAL_CHECK)
+#define EVAL_CHECK
+#endif
+
+const int MaxStaticEvaluation = 10000; // stays clear of mate and table scores, like the network's
+
+// Static evaluation from the side to move's point of view: material and
+// piece-square tables blended between middlegame and endgame by the material
+// left on the board, plus each side's minerals, mining income and training
+// queue. GameState keeps the sums up to date through every move, so this is a
+// handful of adds.
+inline int Evaluate(const GameState& state)
+{
+#ifdef EVAL_CHECK
+    if (!(state.eval == state.ComputeEval()))
+    {
+        std::fprintf(stderr, "Evaluate: incremental terms differ from a full recompute\n");
+        std::abort();
+    }
+#endif
+    const EvalTerms& e = state.eval;
+    int phase = std::min(e.phase, MaxPhase);
+    int score[2];
+    for (int side = White; side <= Black; side++)
+        score[side] = (e.mg[side] * phase + e.eg[side] * (MaxPhase - phase)) / MaxPhase + e.economy[side];
+    int us = state.sideToMove;
+    return std::clamp(score[us] - score[us ^ 1], -MaxStaticEvaluation, MaxStaticEvaluation);
+}
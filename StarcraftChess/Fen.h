@@ -0,0 +1,124 @@
+#pragma once
+#include <cctype>
+#include <sstream>
+#include <string>
+#include "GameState.h"
+
+// Forsyth-Edwards notation for positions. Files a-h are x 1-8 and ranks 1-8
+// are y 1-8, white starts on ranks 1 and 2.
+
+const std::string StartFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+inline int FenPieceIndex(char c)
+{
+    const char* letters = "prnbqk";
+    for (int i = 0; i < PieceTypeCount; i++)
+        if (letters[i] == (char)std::tolower(c))
+            return i;
+    return -1;
+}
+
+// Returns false and leaves state cleared if the string can't be read
+inline bool ParseFen(const std::string& fen, GameState& state)
+{
+    state.Clear();
+    std::istringstream in(fen);
+    std::string placement, side, castling, ep;
+    int halfmoves = 0;
+    if (!(in >> placement >> side))
+        return false;
+    if (!(in >> castling))
+        castling = "-";
+    if (!(in >> ep))
+        ep = "-";
+    in >> halfmoves;
+
+    int x = 1;
+    int y = 8;
+    for (char c : placement)
+    {
+        if (c == '/')
+        {
+            x = 1;
+            y--;
+        }
+        else if (c >= '1' && c <= '8')
+            x += c - '0';
+        else
+        {
+            int t = FenPieceIndex(c);
+            if (t < 0 || !OnBoard(x, y))
+            {
+                state.Clear();
+                return false;
+            }
+            state.AddPiece(SquareOf(x, y), (PieceType)t, std::isupper((unsigned char)c) ? White : Black);
+            x++;
+        }
+    }
+
+    if (side == "b")
+        state.SwitchSide();
+
+    int rights = 0;
+    for (char c : castling)
+    {
+        if (c == 'K') rights |= WhiteKingSide;
+        if (c == 'Q') rights |= WhiteQueenSide;
+        if (c == 'k') rights |= BlackKingSide;
+        if (c == 'q') rights |= BlackQueenSide;
+    }
+    state.SetCastling(rights);
+
+    if (ep.size() == 2 && ep[0] >= 'a' && ep[0] <= 'h' && ep[1] >= '1' && ep[1] <= '8')
+        state.SetEnPassant(SquareOf(ep[0] - 'a' + 1, ep[1] - '0'));
+    state.halfmoveClock = halfmoves;
+    return true;
+}
+
+inline std::string ToFen(const GameState& state)
+{
+    std::string fen;
+    for (int y = 8; y >= 1; y--)
+    {
+        int empty = 0;
+        for (int x = 1; x <= 8; x++)
+        {
+            int sq = SquareOf(x, y);
+            int side = state.board.SideAt(sq);
+            if (side == -1)
+            {
+                empty++;
+                continue;
+            }
+            if (empty)
+                fen += (char)('0' + empty);
+            empty = 0;
+            char c = "prnbqk"[(int)state.board.TypeAt(sq)];
+            fen += side == White ? (char)std::toupper(c) : c;
+        }
+        if (empty)
+            fen += (char)('0' + empty);
+        if (y > 1)
+            fen += '/';
+    }
+
+    fen += state.sideToMove == White ? " w " : " b ";
+    if (state.castling & WhiteKingSide) fen += 'K';
+    if (state.castling & WhiteQueenSide) fen += 'Q';
+    if (state.castling & BlackKingSide) fen += 'k';
+    if (state.castling & BlackQueenSide) fen += 'q';
+    if (!state.castling)
+        fen += '-';
+
+    fen += ' ';
+    if (state.epSquare != NoSquare)
+    {
+        fen += (char)('a' + SquareX(state.epSquare) - 1);
+        fen += (char)('0' + SquareY(state.epSquare));
+    }
+    else
+        fen += '-';
+    fen += " " + std::to_string(state.halfmoveClock) + " 1";
+    return fen;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Match.h"
+
+// Games written down one per line, for building the opening book and for
+// replaying games outside the window:
+//
+//   1-0 e2e4 e7e5 n*g1f3 pass ...
+//
+// The result comes first (1-0, 0-1, 1/2 or * for unfinished), then a token
+// per turn: the move in coordinate notation or "pass", after "<unit>*" when
+// the side queued a unit before it (p, r, n, b or q).
+
+inline std::string ResultToken(GameResult result)
+{
+    switch (result)
+    {
+    case GameResult::WhiteWins: return "1-0";
+    case GameResult::BlackWins: return "0-1";
+    case GameResult::Draw: return "1/2";
+    default: return "*";
+    }
+}
+
+inline bool ParseResultToken(const std::string& token, GameResult& result)
+{
+    for (GameResult r : { GameResult::Ongoing, GameResult::WhiteWins, GameResult::BlackWins, GameResult::Draw })
+        if (token == ResultToken(r))
+        {
+            result = r;
+            return true;
+        }
+    return false;
+}
+
+// trained is the PieceType queued this turn as an int, -1 for none
+inline std::string TurnToken(int trained, const Move& m)
+{
+    std::string token;
+    if (trained >= 0)
+    {
+        token += "prnbqk"[trained];
+        token += '*';
+    }
+    return token + (m.IsNull() ? "pass" : m.ToString());
+}
+
+// Splits a turn token into the unit queued first (-1 for none) and the move
+inline bool SplitTurnToken(const std::string& token, int& trained, std::string& move)
+{
+    trained = -1;
+    move = token;
+    size_t star = token.find('*');
+    if (star == std::string::npos)
+        return true;
+    const char* units = "prnbq";
+    const char* unit = star == 1 ? std::strchr(units, token[0]) : nullptr;
+    if (!unit || !*unit)
+        return false;
+    trained = (int)(unit - units);
+    move = token.substr(star + 1);
+    return true;
+}
+
+// The legal move a move token names, a null move for "pass", which is only
+// allowed when the side has nothing to move
+inline bool FindTokenMove(const Match& match, const std::string& move, Move& out)
+{
+    MoveList moves;
+    match.LegalMoves(moves);
+    out = Move();
+    if (move == "pass")
+        return moves.Empty();
+    for (const Move& m : moves)
+        if (m.ToString() == move)
+        {
+            out = m;
+            return true;
+        }
+    return false;
+}
+
+// Queues the unit a turn token names and finds its move, false if either
+// isn't legal here. Playing the move is left to the caller, so it can look at
+// the position the move is played from first.
+inline bool BeginTurnToken(Match& match, const std::string& token, Move& m)
+{
+    int trained;
+    std::string move;
+    if (!SplitTurnToken(token, trained, move))
+        return false;
+    if (trained >= 0 && !match.Train((PieceType)trained))
+        return false;
+    return FindTokenMove(match, move, m);
+}
+
+// Splits a record line into its result and turn tokens
+inline bool ParseRecord(const std::string& line, GameResult& result, std::vector<std::string>& turns)
+{
+    std::istringstream in(line);
+    std::string token;
+    turns.clear();
+    if (!(in >> token) || !ParseResultToken(token, result))
+        return false;
+    while (in >> token)
+        turns.push_back(token);
+    return true;
+}
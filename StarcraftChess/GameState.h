@@ -0,0 +1,567 @@
+#pragma once
+#include "BoardState.h"
+#include "Economy.h"
+#include "Zobrist.h"
+#include "Move.h"
+#include "PieceSquare.h"
+
+// Castling rights bits
+const int WhiteKingSide = 1;
+const int WhiteQueenSide = 2;
+const int BlackKingSide = 4;
+const int BlackQueenSide = 8;
+
+const int TrainingQueueSize = 5; // orders a side can have queued at once
+static_assert(TrainingQueueSize <= Zobrist::MaxQueueSlots, "not enough queue hash keys");
+
+const int TurnIncome = 10; // minerals a side earns at the end of each of its turns
+
+struct TrainingOrder {
+    PieceType type;
+    int turnsLeft;
+};
+
+// What MakeMove needs to put a position back, everything else follows from the move
+struct UndoInfo {
+    uint64_t hash;
+    int32_t minerals; // the mover's bank before its income
+    int16_t halfmoveClock;
+    int8_t epSquare;
+    uint8_t castling;
+    int8_t captured; // PieceType taken, -1 for none
+    bool capturedUnit;
+    bool trainingTicked;
+    int8_t spawnSquare; // where a finished unit appeared, NoSquare for none
+    int16_t mined[MaxMineralNodes]; // what the mover's tick took from each node
+};
+
+// Everything that identifies a position: the board, whose turn it is, castling
+// and en passant, and each side's economy. The Zobrist hash, material and the
+// evaluation terms are kept up to date by every mutator, so they never need to
+// be recomputed during play. A move is a whole turn, so playing one also pays the mover's income
+// and mining and works on its training queue. Match runs the income and the
+// finished units off its own timers instead, through the same steps.
+struct GameState {
+    BoardState board;
+    int sideToMove = White;
+    int castling = 0;
+    int epSquare = NoSquare; // square a pawn skipped over with a double push
+    int halfmoveClock = 0; // turns since the last capture or pawn move
+    int minerals[2] = {};
+    MineralNodes mining;
+    TrainingOrder training[2][TrainingQueueSize] = {};
+    int trainingCount[2] = {};
+    int material[2] = {}; // sum of PieceValues on the board
+    EvalTerms eval;
+    uint64_t hash = Zobrist::Keys.minerals[White][0] ^ Zobrist::Keys.minerals[Black][0];
+
+    void Clear()
+    {
+        *this = GameState();
+    }
+
+    void AddPiece(int sq, PieceType t, int side, bool trained = false)
+    {
+        PutPiece(sq, t, side, trained);
+        hash ^= Zobrist::Keys.pieces[side][(int)t][sq];
+        if (trained)
+            hash ^= Zobrist::Keys.units[sq];
+    }
+
+    void RemovePiece(int sq)
+    {
+        int side = board.SideAt(sq);
+        int t = (int)board.TypeAt(sq);
+        hash ^= Zobrist::Keys.pieces[side][t][sq];
+        if (board.units & SquareBit(sq))
+            hash ^= Zobrist::Keys.units[sq];
+        TakePiece(sq);
+    }
+
+    // Moves a piece to an empty square, captures have to remove the target first
+    void MovePiece(int from, int to)
+    {
+        int side = board.SideAt(from);
+        int t = (int)board.TypeAt(from);
+        hash ^= Zobrist::Keys.pieces[side][t][from] ^ Zobrist::Keys.pieces[side][t][to];
+        if (board.units & SquareBit(from))
+            hash ^= Zobrist::Keys.units[from] ^ Zobrist::Keys.units[to];
+        ShiftPiece(from, to);
+
+        // Moving a king or rook off its home square, or taking a rook there, loses the right
+        SetCastling(castling & CastlingMask(from) & CastlingMask(to));
+        SetEnPassant(t == (int)PieceType::Pawn && (from ^ to) == 16 ? (from + to) / 2 : NoSquare);
+    }
+
+    // Plays a whole turn for the side to move: the move with its captures,
+    // castling, en passant and promotion, then the turn's economy. undo gets
+    // what UnmakeMove needs to take it back. Without economy only the training
+    // queue counts down, the owner collects income and brings out units itself.
+    void MakeMove(const Move& m, UndoInfo& undo, bool economy = true)
+    {
+        MovePieces(m, undo);
+        FinishTurn(undo, economy);
+    }
+
+    // Just the move, the turn goes on. The search only ever plays one move a
+    // turn through MakeMove, Match moves as many pieces as the side likes and
+    // ends the turn with EndTurn.
+    void MovePieces(const Move& m, UndoInfo& undo)
+    {
+        int us = sideToMove;
+        SaveUndo(undo);
+        bool resetClock = board.TypeAt(m.from) == PieceType::Pawn;
+
+        int captureSq = m.flag == MoveFlag::EnPassant ? m.to + (us == White ? -8 : 8) : m.to;
+        if (board.IsOccupied(captureSq))
+        {
+            undo.captured = (int8_t)board.TypeAt(captureSq);
+            undo.capturedUnit = board.units & SquareBit(captureSq);
+            RemovePiece(captureSq);
+            resetClock = true;
+        }
+
+        MovePiece(m.from, m.to);
+
+        if (m.flag == MoveFlag::Castle)
+        {
+            int y = SquareY(m.to);
+            if (m.to > m.from)
+                MovePiece(SquareOf(8, y), SquareOf(6, y));
+            else
+                MovePiece(SquareOf(1, y), SquareOf(4, y));
+        }
+        else if (m.flag == MoveFlag::Promotion)
+        {
+            bool trained = board.units & SquareBit(m.to);
+            RemovePiece(m.to);
+            AddPiece(m.to, m.promotion, us, trained);
+        }
+
+        halfmoveClock = resetClock ? 0 : halfmoveClock + 1;
+    }
+
+    void UnmakeMove(const Move& m, const UndoInfo& undo)
+    {
+        UnfinishTurn(undo);
+        int us = sideToMove;
+
+        if (m.flag == MoveFlag::Promotion)
+        {
+            bool trained = board.units & SquareBit(m.to);
+            TakePiece(m.to);
+            PutPiece(m.to, PieceType::Pawn, us, trained);
+        }
+        else if (m.flag == MoveFlag::Castle)
+        {
+            int y = SquareY(m.to);
+            if (m.to > m.from)
+                ShiftPiece(SquareOf(6, y), SquareOf(8, y));
+            else
+                ShiftPiece(SquareOf(4, y), SquareOf(1, y));
+        }
+
+        ShiftPiece(m.to, m.from);
+
+        if (undo.captured >= 0)
+        {
+            int captureSq = m.flag == MoveFlag::EnPassant ? m.to + (us == White ? -8 : 8) : m.to;
+            PutPiece(captureSq, (PieceType)undo.captured, us ^ 1, undo.capturedUnit);
+        }
+        RestoreUndo(undo);
+    }
+
+    // Passes the turn without moving, used by the search's null move pruning
+    void MakeNullMove(UndoInfo& undo)
+    {
+        SaveUndo(undo);
+        SetEnPassant(NoSquare);
+        halfmoveClock++;
+        FinishTurn(undo, true);
+    }
+
+    // Also takes back EndTurn
+    void UnmakeNullMove(const UndoInfo& undo)
+    {
+        UnfinishTurn(undo);
+        RestoreUndo(undo);
+    }
+
+    // Hands the turn over after the moves played with MovePieces, if any
+    void EndTurn(UndoInfo& undo, bool economy = true)
+    {
+        SaveUndo(undo);
+        FinishTurn(undo, economy);
+    }
+
+    void PlayMove(const Move& m)
+    {
+        UndoInfo undo;
+        MakeMove(m, undo);
+    }
+
+    void PlayNullMove()
+    {
+        UndoInfo undo;
+        MakeNullMove(undo);
+    }
+
+    void SetCastling(int rights)
+    {
+        hash ^= Zobrist::Keys.castling[castling] ^ Zobrist::Keys.castling[rights];
+        castling = rights;
+    }
+
+    // Grants the castling rights the king and rook placement still allows
+    void SetCastlingFromBoard()
+    {
+        int rights = 0;
+        for (int side = White; side <= Black; side++)
+        {
+            int y = side == White ? 1 : 8;
+            if (!(board.Pieces(side, PieceType::King) & SquareBit(SquareOf(5, y))))
+                continue;
+            Bitboard rooks = board.Pieces(side, PieceType::Rook);
+            if (rooks & SquareBit(SquareOf(8, y)))
+                rights |= side == White ? WhiteKingSide : BlackKingSide;
+            if (rooks & SquareBit(SquareOf(1, y)))
+                rights |= side == White ? WhiteQueenSide : BlackQueenSide;
+        }
+        SetCastling(rights);
+    }
+
+    void SetEnPassant(int sq)
+    {
+        if (epSquare != NoSquare)
+            hash ^= Zobrist::Keys.enPassant[epSquare & 7];
+        epSquare = sq;
+        if (epSquare != NoSquare)
+            hash ^= Zobrist::Keys.enPassant[epSquare & 7];
+    }
+
+    void SwitchSide()
+    {
+        sideToMove ^= 1;
+        hash ^= Zobrist::Keys.blackToMove;
+    }
+
+    void SetMinerals(int side, int amount)
+    {
+        hash ^= Zobrist::Keys.minerals[side][Zobrist::MineralBucket(minerals[side])];
+        eval.economy[side] += MineralsValue(amount) - MineralsValue(minerals[side]);
+        minerals[side] = amount;
+        hash ^= Zobrist::Keys.minerals[side][Zobrist::MineralBucket(minerals[side])];
+    }
+
+    // Puts a mineral node on the board, pieces already around it start working it
+    bool AddMineralNode(int sq, int amount, int perWorker)
+    {
+        int before[2] = { mining.income[White], mining.income[Black] };
+        if (!mining.Add(sq, amount, perWorker))
+            return false;
+        for (int side = White; side <= Black; side++)
+        {
+            Bitboard b = board.Pieces(side) & mining.area[mining.count - 1];
+            while (b)
+                mining.MoveWorker(side, PopLowest(b), 1);
+        }
+        IncomeChanged(before);
+        SetMineralField(sq, amount > 0);
+        return true;
+    }
+
+    void SetMineralField(int sq, bool present)
+    {
+        if (((board.minerals & SquareBit(sq)) != 0) == present)
+            return;
+        board.minerals ^= SquareBit(sq);
+        hash ^= Zobrist::Keys.mineralFields[sq];
+    }
+
+    bool QueueTraining(int side, PieceType t, int turns)
+    {
+        if (trainingCount[side] >= TrainingQueueSize)
+            return false;
+        int slot = trainingCount[side]++;
+        training[side][slot] = { t, turns };
+        hash ^= QueueKey(side, slot);
+        eval.economy[side] += TrainingValue(t, turns);
+        return true;
+    }
+
+    void SetTrainingTurns(int side, int slot, int turns)
+    {
+        TrainingOrder& order = training[side][slot];
+        hash ^= QueueKey(side, slot);
+        eval.economy[side] += TrainingValue(order.type, turns) - TrainingValue(order.type, order.turnsLeft);
+        order.turnsLeft = turns;
+        hash ^= QueueKey(side, slot);
+    }
+
+    // Takes an order out of the queue, the ones behind it move up a slot
+    TrainingOrder RemoveTraining(int side, int slot)
+    {
+        TrainingOrder order = training[side][slot];
+        eval.economy[side] -= TrainingValue(order.type, order.turnsLeft);
+        for (int i = slot; i < trainingCount[side]; i++)
+            hash ^= QueueKey(side, i);
+        for (int i = slot; i + 1 < trainingCount[side]; i++)
+            training[side][i] = training[side][i + 1];
+        trainingCount[side]--;
+        for (int i = slot; i < trainingCount[side]; i++)
+            hash ^= QueueKey(side, i);
+        return order;
+    }
+
+    // A turn's income for side, what its workers mine included, added to its bank
+    int CollectIncome(int side, UndoInfo& undo)
+    {
+        undo.minerals = minerals[side];
+        int income = TurnIncome + Mine(side, undo);
+        SetMinerals(side, minerals[side] + income);
+        return income;
+    }
+
+    // The front of side's queue one turn nearer to done
+    void CountDownTraining(int side, UndoInfo& undo)
+    {
+        undo.trainingTicked = false;
+        if (trainingCount[side] && training[side][0].turnsLeft > 0)
+        {
+            SetTrainingTurns(side, 0, training[side][0].turnsLeft - 1);
+            undo.trainingTicked = true;
+        }
+    }
+
+    // Brings the front of side's queue out on its home rank once it's done,
+    // returns the square or NoSquare when nothing came out
+    int SpawnTrained(int side, UndoInfo& undo)
+    {
+        undo.spawnSquare = NoSquare;
+        if (!trainingCount[side] || training[side][0].turnsLeft > 0)
+            return NoSquare;
+        int sq = SpawnSquare(side);
+        if (sq == NoSquare)
+            return NoSquare;
+        TrainingOrder order = RemoveTraining(side, 0);
+        AddPiece(sq, order.type, side, true);
+        undo.spawnSquare = (int8_t)sq;
+        return sq;
+    }
+
+    // A side with nothing on the board and nothing in training has lost
+    bool IsEliminated(int side) const
+    {
+        return !board.Pieces(side) && !trainingCount[side];
+    }
+
+    // Free square on the home rank nearest the middle, units wait in the queue while it's full
+    int SpawnSquare(int side) const
+    {
+        int y = side == White ? 1 : 8;
+        for (int x : { 4, 5, 3, 6, 2, 7, 1, 8 })
+            if (!board.IsOccupied(SquareOf(x, y)))
+                return SquareOf(x, y);
+        return NoSquare;
+    }
+
+    // Full recompute of the hash, for checking the incremental one and for desync checks
+    uint64_t ComputeHash() const
+    {
+        uint64_t h = 0;
+        for (int side = White; side <= Black; side++)
+            for (int t = 0; t < PieceTypeCount; t++)
+            {
+                Bitboard b = board.Pieces(side, (PieceType)t);
+                while (b)
+                    h ^= Zobrist::Keys.pieces[side][t][PopLowest(b)];
+            }
+        Bitboard b = board.units;
+        while (b)
+            h ^= Zobrist::Keys.units[PopLowest(b)];
+        b = board.minerals;
+        while (b)
+            h ^= Zobrist::Keys.mineralFields[PopLowest(b)];
+        if (sideToMove == Black)
+            h ^= Zobrist::Keys.blackToMove;
+        h ^= Zobrist::Keys.castling[castling];
+        if (epSquare != NoSquare)
+            h ^= Zobrist::Keys.enPassant[epSquare & 7];
+        for (int side = White; side <= Black; side++)
+        {
+            h ^= Zobrist::Keys.minerals[side][Zobrist::MineralBucket(minerals[side])];
+            for (int slot = 0; slot < trainingCount[side]; slot++)
+                h ^= QueueKey(side, slot);
+        }
+        return h;
+    }
+
+    // Full recompute of the evaluation terms, for checking the incremental ones
+    EvalTerms ComputeEval() const
+    {
+        EvalTerms e;
+        for (int side = White; side <= Black; side++)
+        {
+            for (int t = 0; t < PieceTypeCount; t++)
+            {
+                Bitboard b = board.Pieces(side, (PieceType)t);
+                while (b)
+                    e.AddPiece(side, (PieceType)t, PopLowest(b));
+            }
+            e.economy[side] = MineralsValue(minerals[side]) + IncomeValue(mining.CountIncome(board.Pieces(side)));
+            for (int slot = 0; slot < trainingCount[side]; slot++)
+                e.economy[side] += TrainingValue(training[side][slot].type, training[side][slot].turnsLeft);
+        }
+        return e;
+    }
+
+    static int CastlingMask(int sq)
+    {
+        switch (sq)
+        {
+        case SquareOf(5, 1): return ~(WhiteKingSide | WhiteQueenSide);
+        case SquareOf(8, 1): return ~WhiteKingSide;
+        case SquareOf(1, 1): return ~WhiteQueenSide;
+        case SquareOf(5, 8): return ~(BlackKingSide | BlackQueenSide);
+        case SquareOf(8, 8): return ~BlackKingSide;
+        case SquareOf(1, 8): return ~BlackQueenSide;
+        default: return ~0;
+        }
+    }
+
+private:
+    // Board changes with the material and evaluation that follow them but not
+    // the hash, which UnmakeMove restores from the undo record instead
+    void PutPiece(int sq, PieceType t, int side, bool trained)
+    {
+        board.AddPiece(sq, t, side, trained);
+        material[side] += PieceValues[(int)t];
+        eval.AddPiece(side, t, sq);
+        Work(side, sq, 1);
+    }
+
+    void TakePiece(int sq)
+    {
+        int side = board.SideAt(sq);
+        PieceType t = board.TypeAt(sq);
+        material[side] -= PieceValues[(int)t];
+        eval.RemovePiece(side, t, sq);
+        board.RemovePiece(sq);
+        Work(side, sq, -1);
+    }
+
+    void ShiftPiece(int from, int to)
+    {
+        int side = board.SideAt(from);
+        eval.MovePiece(side, board.TypeAt(from), from, to);
+        board.MovePiece(from, to);
+        Work(side, from, -1);
+        Work(side, to, 1);
+    }
+
+    // A piece of side came to (+1) or left (-1) sq, which may change what it mines
+    void Work(int side, int sq, int delta)
+    {
+        if (!(mining.areas & SquareBit(sq)))
+            return;
+        int before = mining.income[side];
+        mining.MoveWorker(side, sq, delta);
+        eval.economy[side] += IncomeValue(mining.income[side]) - IncomeValue(before);
+    }
+
+    // Moves the income terms after the nodes changed under both sides
+    void IncomeChanged(const int* before)
+    {
+        for (int side = White; side <= Black; side++)
+            eval.economy[side] += IncomeValue(mining.income[side]) - IncomeValue(before[side]);
+    }
+
+    // The mover's mining tick, nodes that run dry leave the board
+    int Mine(int us, UndoInfo& undo)
+    {
+        int before[2] = { mining.income[White], mining.income[Black] };
+        int total = mining.Tick(us, undo.mined);
+        if (total == 0)
+            return 0;
+        IncomeChanged(before);
+        for (int n = 0; n < mining.count; n++)
+            if (undo.mined[n] && mining.remaining[n] == 0)
+                SetMineralField(mining.square[n], false);
+        return total;
+    }
+
+    void SaveUndo(UndoInfo& undo) const
+    {
+        undo.hash = hash;
+        undo.halfmoveClock = (int16_t)halfmoveClock;
+        undo.epSquare = (int8_t)epSquare;
+        undo.castling = (uint8_t)castling;
+        undo.captured = -1;
+        undo.capturedUnit = false;
+    }
+
+    // Takes back what the undo record holds outright, after the pieces are back
+    void RestoreUndo(const UndoInfo& undo)
+    {
+        hash = undo.hash;
+        halfmoveClock = undo.halfmoveClock;
+        epSquare = undo.epSquare;
+        castling = undo.castling;
+    }
+
+    // The mover's income and what its workers mine, then its front training
+    // order ticks down and comes out on the home rank once it's done
+    void FinishTurn(UndoInfo& undo, bool economy)
+    {
+        int us = sideToMove;
+        undo.minerals = minerals[us];
+        undo.spawnSquare = NoSquare;
+        for (int16_t& taken : undo.mined)
+            taken = 0;
+        if (economy)
+            CollectIncome(us, undo);
+        CountDownTraining(us, undo);
+        if (economy)
+            SpawnTrained(us, undo);
+        SwitchSide();
+    }
+
+    // Reverses FinishTurn apart from the hash, which RestoreUndo puts back
+    void UnfinishTurn(const UndoInfo& undo)
+    {
+        sideToMove ^= 1;
+        int us = sideToMove;
+        if (undo.spawnSquare != NoSquare)
+        {
+            PieceType t = board.TypeAt(undo.spawnSquare);
+            TakePiece(undo.spawnSquare);
+            for (int i = trainingCount[us]; i > 0; i--)
+                training[us][i] = training[us][i - 1];
+            training[us][0] = { t, 0 };
+            trainingCount[us]++;
+            eval.economy[us] += TrainingValue(t, 0);
+        }
+        if (undo.trainingTicked)
+        {
+            TrainingOrder& order = training[us][0];
+            eval.economy[us] += TrainingValue(order.type, order.turnsLeft + 1) - TrainingValue(order.type, order.turnsLeft);
+            order.turnsLeft++;
+        }
+        eval.economy[us] += MineralsValue(undo.minerals) - MineralsValue(minerals[us]);
+        minerals[us] = undo.minerals;
+
+        int before[2] = { mining.income[White], mining.income[Black] };
+        mining.Restore(undo.mined);
+        IncomeChanged(before);
+        for (int n = 0; n < mining.count; n++)
+            if (undo.mined[n])
+                board.minerals |= SquareBit(mining.square[n]);
+    }
+
+    uint64_t QueueKey(int side, int slot) const
+    {
+        const TrainingOrder& order = training[side][slot];
+        return Zobrist::Keys.queueType[side][slot][(int)order.type]
+            ^ Zobrist::Keys.queueTurns[side][slot][Zobrist::QueueTurns(order.turnsLeft)];
+    }
+};
@@ -0,0 +1,298 @@
+#pragma once
+#include <vector>
+#include "MoveGen.h"
+#include "TimerWheel.h"
+
+// The rules of a whole game on top of GameState: the starting setup, turns,
+// the economy and the result. Nothing here touches the window, the clock or
+// the mouse, so the same code drives the game on screen and headless
+// self-play on machines without a display.
+
+enum class GameResult {
+    Ongoing,
+    WhiteWins,
+    BlackWins,
+    Draw
+};
+
+// Training cost in minerals and turns indexed by PieceType, kings can't be trained
+const int TrainingCosts[PieceTypeCount] = { 50, 250, 150, 150, 450, 0 };
+const int TrainingTurns[PieceTypeCount] = { 2, 4, 3, 3, 6, 0 };
+const int StartingMinerals = 50;
+
+// Mineral nodes, one each side of both home halves, so the pawns beside them
+// start out mining and pushing them costs income
+const int MineralNodeSquares[] = { SquareOf(1, 3), SquareOf(8, 3), SquareOf(1, 6), SquareOf(8, 6) };
+const int MineralNodeAmount = 400;
+const int MineralNodeYield = 2; // per worker per turn
+
+enum class MatchEventType : uint8_t {
+    UnitTrained, // a queued unit came out on its home rank
+    Income // a side's turn paid out, mining included
+};
+
+// Something timed that happened at the end of a turn, also what the match's
+// timers carry until then
+struct MatchEvent {
+    MatchEventType type = MatchEventType::UnitTrained;
+    int8_t side = White;
+    PieceType piece = PieceType::Pawn; // what was trained, for UnitTrained
+    int8_t square = NoSquare; // where it happened, once it has
+    int16_t minerals = 0; // what was paid, for Income
+};
+
+class Match {
+public:
+    GameState state;
+    std::vector<uint64_t> history; // hash at the start of every earlier turn, for repetition
+    int turns = 0; // turns ended so far by both sides
+    std::vector<MatchEvent> events; // what the last turn's end brought, for the front end
+    Bitboard moved = 0; // pieces that moved this turn, each may move once before the turn ends
+
+    // Timed work on the match's clock, which ticks once per turn. Each side's
+    // income recurs every other tick and each queued unit has a timer for the
+    // turn it's due, what fires is paid out and brought onto the board here.
+    // The position only counts its queues down, the search plays the rest of
+    // the economy out itself move by move.
+    TimerWheel<MatchEvent> timers;
+    TimerId trainingTimers[2][TrainingQueueSize] = {}; // parallel to the state's queues
+
+    // Sets up the variant's opening: a row of pawns each and nothing else
+    void Reset()
+    {
+        state.Clear();
+        for (int sq : MineralNodeSquares)
+            state.AddMineralNode(sq, MineralNodeAmount, MineralNodeYield);
+        for (int x = 1; x <= 8; x++)
+        {
+            state.AddPiece(SquareOf(x, 2), PieceType::Pawn, White);
+            state.AddPiece(SquareOf(x, 7), PieceType::Pawn, Black);
+        }
+        state.SetCastlingFromBoard();
+        state.SetMinerals(White, StartingMinerals);
+        state.SetMinerals(Black, StartingMinerals);
+        history.clear();
+        turns = 0;
+        events.clear();
+        moved = 0;
+        turnEnPassant = NoSquare;
+        timers.Clear();
+        for (auto& side : trainingTimers)
+            for (TimerId& id : side)
+                id = 0;
+        // Each side is paid at the end of its own turns
+        timers.Schedule(1, { MatchEventType::Income, (int8_t)state.sideToMove });
+        timers.Schedule(2, { MatchEventType::Income, (int8_t)(state.sideToMove ^ 1) });
+        turnStartHash = state.hash;
+    }
+
+    // What the side to move can still play this turn, pieces that moved already sit it out
+    void LegalMoves(MoveList& moves) const
+    {
+        GenerateLegalMoves(state, moves);
+        if (!moved)
+            return;
+        int kept = 0;
+        for (int i = 0; i < moves.Size(); i++)
+            if (!(moved & SquareBit(moves[i].from)))
+                moves[kept++] = moves[i];
+        moves.Resize(kept);
+    }
+
+    bool HasMoved(int sq) const
+    {
+        return moved & SquareBit(sq);
+    }
+
+    // Moves one piece for the side to move, m comes from LegalMoves. The turn
+    // goes on until EndTurn, any other piece that hasn't moved can still go.
+    void PlayMove(const Move& m)
+    {
+        UndoInfo undo;
+        state.MovePieces(m, undo);
+        moved |= SquareBit(m.to);
+        if (m.flag == MoveFlag::Castle)
+            moved |= SquareBit(m.to > m.from ? m.to - 1 : m.to + 1);
+        // A double push opens en passant for the other side's turn, not for the rest of this one
+        if (state.epSquare != NoSquare)
+        {
+            turnEnPassant = state.epSquare;
+            state.SetEnPassant(NoSquare);
+        }
+    }
+
+    // Ends the side to move's turn, however many of its pieces moved
+    void EndTurn()
+    {
+        if (turnEnPassant != NoSquare)
+            state.SetEnPassant(turnEnPassant);
+        moved = 0;
+        turnEnPassant = NoSquare;
+        UndoInfo undo;
+        state.EndTurn(undo, false);
+        FinishTurn();
+    }
+
+    // One move and the end of the turn, the way the AI and the tools play,
+    // a null move only ends it
+    void PlayTurn(const Move& m)
+    {
+        if (!m.IsNull())
+            PlayMove(m);
+        EndTurn();
+    }
+
+    bool CanTrain(PieceType t) const
+    {
+        int side = state.sideToMove;
+        return TrainingCosts[(int)t] > 0 && state.minerals[side] >= TrainingCosts[(int)t]
+            && state.trainingCount[side] < TrainingQueueSize;
+    }
+
+    // Pays for a unit and queues it for the side to move
+    bool Train(PieceType t)
+    {
+        if (!CanTrain(t))
+            return false;
+        int side = state.sideToMove;
+        state.SetMinerals(side, state.minerals[side] - TrainingCosts[(int)t]);
+        state.QueueTraining(side, t, TrainingTurns[(int)t]);
+        ScheduleTraining(side, state.trainingCount[side] - 1);
+        return true;
+    }
+
+    // Queues the most expensive unit the side to move can afford whenever
+    // nothing is training, how the AI and self-play train. Returns the
+    // PieceType queued or -1.
+    int TrainStrongest()
+    {
+        if (state.trainingCount[state.sideToMove])
+            return -1;
+        for (PieceType t : { PieceType::Queen, PieceType::Rook, PieceType::Bishop, PieceType::Knight, PieceType::Pawn })
+            if (Train(t))
+                return (int)t;
+        return -1;
+    }
+
+    // Takes an order out of the side to move's queue and pays it back
+    bool CancelTraining(int slot)
+    {
+        int side = state.sideToMove;
+        if (slot < 0 || slot >= state.trainingCount[side])
+            return false;
+        TrainingOrder order = state.RemoveTraining(side, slot);
+        state.SetMinerals(side, state.minerals[side] + TrainingCosts[(int)order.type]);
+        timers.Cancel(trainingTimers[side][slot]);
+        for (int i = slot; i < state.trainingCount[side]; i++)
+        {
+            // Everything behind it is due sooner now
+            timers.Cancel(trainingTimers[side][i + 1]);
+            ScheduleTraining(side, i);
+        }
+        trainingTimers[side][state.trainingCount[side]] = 0;
+        return true;
+    }
+
+    // Turns until the unit in a slot of side's queue is due, 0 for a free slot
+    int TrainingTurnsLeft(int side, int slot) const
+    {
+        return (int)((timers.Remaining(trainingTimers[side][slot]) + 1) / 2);
+    }
+
+    GameResult Result() const
+    {
+        int us = state.sideToMove;
+        GameResult loss = us == White ? GameResult::BlackWins : GameResult::WhiteWins;
+        GameResult win = us == White ? GameResult::WhiteWins : GameResult::BlackWins;
+        if (state.IsEliminated(us))
+            return loss;
+        if (state.IsEliminated(us ^ 1))
+            return win;
+
+        // Stuck without being in check isn't stalemate here, the side passes and trains instead
+        MoveList moves;
+        GenerateLegalMoves(state, moves);
+        if (moves.Empty() && InCheck(state, us))
+            return loss;
+
+        if (state.halfmoveClock >= 100)
+            return GameResult::Draw;
+        int seen = 0;
+        for (uint64_t h : history)
+            if (h == state.hash && ++seen == 2)
+                return GameResult::Draw;
+        return GameResult::Ongoing;
+    }
+
+private:
+    uint64_t turnStartHash = state.hash;
+    int turnEnPassant = NoSquare; // held back from the side still moving
+
+    // Ticks a side's own turns from now, the end of this one is the next tick
+    static uint64_t TurnsToTicks(int turns)
+    {
+        return (uint64_t)std::max(turns * 2 - 1, 1);
+    }
+
+    void ScheduleTraining(int side, int slot)
+    {
+        int due = 0;
+        for (int i = 0; i <= slot; i++)
+            due += state.training[side][i].turnsLeft;
+        trainingTimers[side][slot] = timers.Schedule(TurnsToTicks(due), { MatchEventType::UnitTrained, (int8_t)side, state.training[side][slot].type });
+    }
+
+    // Runs the clock on a tick and pays out and trains whatever is due
+    void FinishTurn()
+    {
+        history.push_back(turnStartHash);
+        turns++;
+
+        events.clear();
+        std::vector<MatchEvent> fired;
+        timers.Advance([&](const MatchEvent& e) { fired.push_back(e); });
+
+        // Income first, a unit that comes out this tick doesn't mine until its side's next turn
+        for (const MatchEvent& e : fired)
+            if (e.type == MatchEventType::Income)
+            {
+                UndoInfo undo;
+                MatchEvent paid = e;
+                paid.minerals = (int16_t)state.CollectIncome(e.side, undo);
+                events.push_back(paid);
+                timers.Schedule(2, e);
+            }
+
+        bool blocked[2] = {};
+        for (const MatchEvent& e : fired)
+            if (e.type == MatchEventType::UnitTrained)
+            {
+                // Orders take two turns at least, so only the front of a side's queue is ever due
+                UndoInfo undo;
+                int sq = state.SpawnTrained(e.side, undo);
+                if (sq == NoSquare)
+                {
+                    blocked[e.side] = true;
+                    continue;
+                }
+                TimerId* queue = trainingTimers[e.side];
+                for (int i = 0; i + 1 < TrainingQueueSize; i++)
+                    queue[i] = queue[i + 1];
+                queue[TrainingQueueSize - 1] = 0;
+                MatchEvent trained = e;
+                trained.square = (int8_t)sq;
+                events.push_back(trained);
+            }
+
+        // A full home rank holds the whole queue up, the front tries again on the side's next turn
+        for (int s = White; s <= Black; s++)
+            for (int i = 0; blocked[s] && i < state.trainingCount[s]; i++)
+            {
+                uint64_t left = timers.Remaining(trainingTimers[s][i]);
+                timers.Cancel(trainingTimers[s][i]);
+                trainingTimers[s][i] = timers.Schedule(left + 2, { MatchEventType::UnitTrained, (int8_t)s, state.training[s][i].type });
+            }
+
+        turnStartHash = state.hash;
+    }
+};
@@ -0,0 +1,362 @@
+#pragma once
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MappedFile.h"
+
+// Baked models: what the OBJ loader made of a model, written out once as
+// interleaved, indexed vertex data so later runs map the file and hand the
+// buffers to the GPU without parsing any text. Each file carries a hash of
+// the .obj and the .mtl files it names, and is baked again when they change.
+//
+// Normals and texture coordinates can be stored as 16-bit integers the GPU
+// scales back itself: a quarter less to read and upload, and well below
+// anything that shows at the size the pieces are drawn.
+namespace MeshCache {
+    enum Flags : uint32_t {
+        QuantizedNormals = 1, // four signed 16-bit, the last unused, instead of three floats
+        QuantizedTexcoords = 2 // two unsigned 16-bit over 0-1 instead of two floats
+    };
+
+    // File layout, little-endian: the header, meshCount mesh records,
+    // materialCount material records, then each mesh's vertices and 16-bit
+    // indices, every block starting on 4 bytes. A vertex is the position as
+    // three floats, then the normal, then the texture coordinate.
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceHash;
+        uint32_t flags; // asked for when baking, meshes only use what fits them
+        uint32_t meshCount;
+        uint32_t materialCount;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(FileHeader) == 32, "the cache header is 32 bytes on disk");
+
+    struct MeshRecord {
+        uint32_t material;
+        uint32_t flags;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+    };
+    static_assert(sizeof(MeshRecord) == 32, "a mesh record is 32 bytes on disk");
+
+    struct MaterialRecord {
+        uint8_t diffuse[4]; // RGBA
+    };
+
+    const char Magic[4] = { 'S', 'C', 'M', 'C' };
+    const uint32_t FileVersion = 1;
+    const char* const FileExtension = ".scmesh";
+    const uint32_t MaxVertices = 65536; // indices are 16-bit
+
+    inline uint32_t NormalOffset(uint32_t)
+    {
+        return 3 * sizeof(float);
+    }
+
+    inline uint32_t TexcoordOffset(uint32_t flags)
+    {
+        return NormalOffset(flags) + (flags & QuantizedNormals ? 4 * sizeof(int16_t) : 3 * sizeof(float));
+    }
+
+    inline uint32_t VertexStride(uint32_t flags)
+    {
+        return TexcoordOffset(flags) + (flags & QuantizedTexcoords ? 2 * sizeof(uint16_t) : 2 * sizeof(float));
+    }
+
+    inline uint64_t Hash(const std::string& bytes, uint64_t h = 14695981039346656037ull)
+    {
+        // FNV-1a
+        for (unsigned char c : bytes)
+            h = (h ^ c) * 1099511628211ull;
+        return h;
+    }
+
+    inline bool ReadWhole(const std::string& path, std::string& bytes)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // Hash of an .obj and every .mtl it names, false when the .obj can't be read.
+    // A missing .mtl still counts, by name, so adding it later rebakes.
+    inline bool HashSources(const std::string& objPath, uint64_t& hash)
+    {
+        std::string obj;
+        if (!ReadWhole(objPath, obj))
+            return false;
+        hash = Hash(obj);
+        std::istringstream lines(obj);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            if (line.compare(0, 7, "mtllib ") != 0)
+                continue;
+            std::string name = line.substr(7);
+            while (!name.empty() && (name.back() == '\r' || name.back() == ' '))
+                name.pop_back();
+            std::string mtl;
+            ReadWhole((std::filesystem::path(objPath).parent_path() / name).string(), mtl);
+            hash = Hash(mtl, Hash(name, hash));
+        }
+        return true;
+    }
+
+    // One mesh as the loader has it: separate arrays, triangles either listed
+    // vertex by vertex or through indices. Anything but positions can be null.
+    struct SourceMesh {
+        const float* positions = nullptr;
+        const float* normals = nullptr;
+        const float* texcoords = nullptr;
+        const uint16_t* indices = nullptr;
+        uint32_t vertexCount = 0;
+        uint32_t indexCount = 0; // 0 when not indexed
+        uint32_t material = 0;
+    };
+
+    // Interleaves, quantises and welds identical vertices, then writes the file
+    inline bool Write(const std::string& path, uint64_t sourceHash, uint32_t flags, const std::vector<SourceMesh>& meshes,
+        const std::vector<MaterialRecord>& materials, std::string& error)
+    {
+        std::vector<MeshRecord> records(meshes.size());
+        std::vector<uint8_t> data;
+        auto align = [&data]() { data.resize((data.size() + 3) & ~(size_t)3); };
+        for (size_t m = 0; m < meshes.size(); m++)
+        {
+            const SourceMesh& source = meshes[m];
+            MeshRecord& record = records[m];
+            record.material = source.material < materials.size() ? source.material : 0;
+            record.flags = flags;
+            // Coordinates outside 0-1 (tiling) stay floats
+            for (uint32_t i = 0; source.texcoords && i < 2 * source.vertexCount; i++)
+                if (source.texcoords[i] < 0.0f || source.texcoords[i] > 1.0f)
+                    record.flags &= ~QuantizedTexcoords;
+            uint32_t stride = VertexStride(record.flags);
+
+            std::vector<uint8_t> vertices;
+            std::vector<uint16_t> indices;
+            std::unordered_map<std::string, uint16_t> welded;
+            std::string vertex(stride, '\0');
+            uint32_t count = source.indexCount ? source.indexCount : source.vertexCount;
+            for (uint32_t k = 0; k < count; k++)
+            {
+                uint32_t v = source.indexCount ? source.indices[k] : k;
+                char* out = &vertex[0];
+                std::memcpy(out, source.positions + 3 * v, 3 * sizeof(float));
+                float normal[3] = {};
+                if (source.normals)
+                    std::memcpy(normal, source.normals + 3 * v, sizeof(normal));
+                if (record.flags & QuantizedNormals)
+                {
+                    int16_t q[4] = {};
+                    for (int c = 0; c < 3; c++)
+                        q[c] = (int16_t)std::lround(std::fmax(-1.0f, std::fmin(1.0f, normal[c])) * 32767.0f);
+                    std::memcpy(out + NormalOffset(record.flags), q, sizeof(q));
+                }
+                else
+                    std::memcpy(out + NormalOffset(record.flags), normal, sizeof(normal));
+                float uv[2] = {};
+                if (source.texcoords)
+                    std::memcpy(uv, source.texcoords + 2 * v, sizeof(uv));
+                if (record.flags & QuantizedTexcoords)
+                {
+                    uint16_t q[2] = { (uint16_t)std::lround(uv[0] * 65535.0f), (uint16_t)std::lround(uv[1] * 65535.0f) };
+                    std::memcpy(out + TexcoordOffset(record.flags), q, sizeof(q));
+                }
+                else
+                    std::memcpy(out + TexcoordOffset(record.flags), uv, sizeof(uv));
+
+                auto [it, added] = welded.try_emplace(vertex, (uint16_t)(vertices.size() / stride));
+                if (added)
+                {
+                    if (welded.size() > MaxVertices)
+                    {
+                        error = path + ": a mesh has more than " + std::to_string(MaxVertices) + " distinct vertices";
+                        return false;
+                    }
+                    vertices.insert(vertices.end(), vertex.begin(), vertex.end());
+                }
+                indices.push_back(it->second);
+            }
+
+            record.vertexCount = (uint32_t)(vertices.size() / stride);
+            record.indexCount = (uint32_t)indices.size();
+            record.vertexOffset = data.size();
+            data.insert(data.end(), vertices.begin(), vertices.end());
+            align();
+            record.indexOffset = data.size();
+            const uint8_t* indexBytes = (const uint8_t*)indices.data();
+            data.insert(data.end(), indexBytes, indexBytes + indices.size() * sizeof(uint16_t));
+            align();
+        }
+
+        // Offsets so far are into the data, which follows the records
+        uint64_t dataStart = sizeof(FileHeader) + records.size() * sizeof(MeshRecord) + materials.size() * sizeof(MaterialRecord);
+        dataStart = (dataStart + 3) & ~(uint64_t)3;
+        for (MeshRecord& record : records)
+        {
+            record.vertexOffset += dataStart;
+            record.indexOffset += dataStart;
+        }
+        FileHeader header = {};
+        std::memcpy(header.magic, Magic, 4);
+        header.version = FileVersion;
+        header.sourceHash = sourceHash;
+        header.flags = flags;
+        header.meshCount = (uint32_t)records.size();
+        header.materialCount = (uint32_t)materials.size();
+
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+        // Written aside and renamed, so a run stopped halfway never leaves half a file
+        std::string temporary = path + ".tmp";
+        FILE* out = std::fopen(temporary.c_str(), "wb");
+        if (!out)
+        {
+            error = "can't write " + temporary;
+            return false;
+        }
+        size_t padding = (size_t)(dataStart - sizeof(FileHeader) - records.size() * sizeof(MeshRecord)
+            - materials.size() * sizeof(MaterialRecord));
+        const uint8_t zeros[4] = {};
+        bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1
+            && std::fwrite(records.data(), sizeof(MeshRecord), records.size(), out) == records.size()
+            && std::fwrite(materials.data(), sizeof(MaterialRecord), materials.size(), out) == materials.size()
+            && std::fwrite(zeros, 1, padding, out) == padding
+            && std::fwrite(data.data(), 1, data.size(), out) == data.size();
+        if (std::fclose(out) != 0 || !ok)
+        {
+            std::remove(temporary.c_str());
+            error = "can't write " + temporary;
+            return false;
+        }
+        std::filesystem::rename(temporary, path, ec);
+        if (ec)
+        {
+            std::remove(temporary.c_str());
+            error = "can't replace " + path;
+            return false;
+        }
+        return true;
+    }
+
+    // One memory-mapped cache file
+    class File {
+    public:
+        // Fails on anything but a whole file of this version baked from the
+        // same sources with the same flags, which the caller takes as stale
+        bool Open(const std::string& path, uint64_t sourceHash, uint32_t flags, std::string& error)
+        {
+            if (!file.Open(path))
+            {
+                error = "can't open " + path;
+                return false;
+            }
+            if (Check(path, sourceHash, flags, error))
+                return true;
+            file.Close();
+            return false;
+        }
+
+        void Close()
+        {
+            file.Close();
+        }
+
+        int MeshCount() const
+        {
+            return (int)header.meshCount;
+        }
+
+        int MaterialCount() const
+        {
+            return (int)header.materialCount;
+        }
+
+        const MeshRecord& Mesh(int i) const
+        {
+            return meshes[i];
+        }
+
+        const MaterialRecord& Material(int i) const
+        {
+            return materials[i];
+        }
+
+        const uint8_t* Vertices(int i) const
+        {
+            return file.Data() + meshes[i].vertexOffset;
+        }
+
+        const uint16_t* Indices(int i) const
+        {
+            return (const uint16_t*)(file.Data() + meshes[i].indexOffset);
+        }
+
+    private:
+        MappedFile file;
+        FileHeader header = {};
+        const MeshRecord* meshes = nullptr;
+        const MaterialRecord* materials = nullptr;
+
+        bool Check(const std::string& path, uint64_t sourceHash, uint32_t flags, std::string& error)
+        {
+            if (file.Size() < sizeof(header))
+            {
+                error = path + " isn't a mesh cache";
+                return false;
+            }
+            std::memcpy(&header, file.Data(), sizeof(header));
+            if (std::memcmp(header.magic, Magic, 4) != 0)
+            {
+                error = path + " isn't a mesh cache";
+                return false;
+            }
+            if (header.version != FileVersion)
+            {
+                error = path + " is version " + std::to_string(header.version) + ", expected " + std::to_string(FileVersion);
+                return false;
+            }
+            if (header.sourceHash != sourceHash || header.flags != flags)
+            {
+                error = path + " is out of date";
+                return false;
+            }
+            uint64_t tableEnd = sizeof(header) + (uint64_t)header.meshCount * sizeof(MeshRecord)
+                + (uint64_t)header.materialCount * sizeof(MaterialRecord);
+            if (file.Size() < tableEnd)
+            {
+                error = path + " is cut short";
+                return false;
+            }
+            meshes = (const MeshRecord*)(file.Data() + sizeof(header));
+            materials = (const MaterialRecord*)(meshes + header.meshCount);
+            for (uint32_t i = 0; i < header.meshCount; i++)
+            {
+                const MeshRecord& m = meshes[i];
+                if (m.vertexOffset % 4 || m.indexOffset % 4 || m.vertexCount > MaxVertices
+                    || m.vertexOffset + (uint64_t)m.vertexCount * VertexStride(m.flags) > file.Size()
+                    || m.indexOffset + (uint64_t)m.indexCount * sizeof(uint16_t) > file.Size()
+                    || (m.material >= header.materialCount && header.materialCount > 0))
+                {
+                    error = path + " is cut short";
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <cassert>
+#include <string>
+#include "Bitboard.h"
+
+enum class MoveFlag : uint8_t {
+    Normal = 0,
+    DoublePush = 1,
+    EnPassant = 2,
+    Castle = 3, // stored as the king's two square move
+    Promotion = 4
+};
+
+struct Move {
+    uint8_t from = 0;
+    uint8_t to = 0;
+    MoveFlag flag = MoveFlag::Normal;
+    PieceType promotion = PieceType::Pawn;
+
+    bool IsNull() const
+    {
+        return from == to;
+    }
+
+    bool operator==(const Move& o) const
+    {
+        return from == o.from && to == o.to && flag == o.flag && promotion == o.promotion;
+    }
+
+    // Packs into the 32 bits the transposition table keeps, 0 is no move
+    uint32_t Encode() const
+    {
+        return from | (to << 6) | ((uint32_t)flag << 12) | ((uint32_t)promotion << 16);
+    }
+
+    static Move Decode(uint32_t data)
+    {
+        Move m;
+        m.from = data & 63;
+        m.to = (data >> 6) & 63;
+        m.flag = (MoveFlag)((data >> 12) & 15);
+        m.promotion = (PieceType)((data >> 16) & 15);
+        return m;
+    }
+
+    // Coordinate notation, files a-h are x 1-8 and ranks 1-8 are y 1-8
+    std::string ToString() const
+    {
+        if (IsNull())
+            return "0000";
+        std::string s;
+        s += (char)('a' + SquareX(from) - 1);
+        s += (char)('0' + SquareY(from));
+        s += (char)('a' + SquareX(to) - 1);
+        s += (char)('0' + SquareY(to));
+        if (flag == MoveFlag::Promotion)
+            s += "prnbqk"[(int)promotion];
+        return s;
+    }
+};
+static_assert(sizeof(Move) == 4, "moves are packed into 32 bits");
+
+// Room for every move a side can have, the variant can train extra queens so
+// this is well over the 218 standard chess allows
+const int MaxMoves = 512;
+
+// Fixed-capacity move list that lives on the stack or inside the searcher,
+// generators append to it directly and it never allocates
+class MoveList {
+private:
+    Move moves[MaxMoves];
+    int count = 0;
+
+public:
+    void Add(const Move& m)
+    {
+        assert(count < MaxMoves);
+        moves[count++] = m;
+    }
+
+    void Clear()
+    {
+        count = 0;
+    }
+
+    // Keeps the first n moves
+    void Resize(int n)
+    {
+        count = n;
+    }
+
+    int Size() const
+    {
+        return count;
+    }
+
+    bool Empty() const
+    {
+        return count == 0;
+    }
+
+    Move& operator[](int i)
+    {
+        return moves[i];
+    }
+
+    const Move& operator[](int i) const
+    {
+        return moves[i];
+    }
+
+    Move* begin() { return moves; }
+    Move* end() { return moves + count; }
+    const Move* begin() const { return moves; }
+    const Move* end() const { return moves + count; }
+};
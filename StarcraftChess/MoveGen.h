@@ -0,0 +1,212 @@
+#pragma once
+#include "GameState.h"
+#include "Attacks.h"
+
+// Move generation on the core GameState, shared by the AI and the tools.
+
+inline int KingSquare(const BoardState& board, int side)
+{
+    Bitboard king = board.Pieces(side, PieceType::King);
+    return king ? LowestSquare(king) : NoSquare;
+}
+
+// Every piece of either side that attacks a square with the given occupancy
+inline Bitboard AttackersTo(const BoardState& board, int sq, Bitboard occupied)
+{
+    return (Attacks::PawnAttacks[Black][sq] & board.Pieces(White, PieceType::Pawn))
+        | (Attacks::PawnAttacks[White][sq] & board.Pieces(Black, PieceType::Pawn))
+        | (Attacks::KnightAttacks[sq] & board.Pieces(PieceType::Knight))
+        | (Attacks::KingAttacks[sq] & board.Pieces(PieceType::King))
+        | (Attacks::Rook(sq, occupied) & (board.Pieces(PieceType::Rook) | board.Pieces(PieceType::Queen)))
+        | (Attacks::Bishop(sq, occupied) & (board.Pieces(PieceType::Bishop) | board.Pieces(PieceType::Queen)));
+}
+
+inline bool IsAttacked(const BoardState& board, int sq, int bySide)
+{
+    return AttackersTo(board, sq, board.Occupied()) & board.Pieces(bySide);
+}
+
+// A side without a king (the variant can be played without them) is never in check
+inline bool InCheck(const GameState& state, int side)
+{
+    int king = KingSquare(state.board, side);
+    return king != NoSquare && IsAttacked(state.board, king, side ^ 1);
+}
+
+inline void AddPawnMoves(MoveList& moves, int from, Bitboard targets, MoveFlag flag)
+{
+    while (targets)
+    {
+        int to = PopLowest(targets);
+        int y = SquareY(to);
+        if (y == 1 || y == 8)
+        {
+            for (PieceType p : { PieceType::Queen, PieceType::Knight, PieceType::Rook, PieceType::Bishop })
+                moves.Add({ (uint8_t)from, (uint8_t)to, MoveFlag::Promotion, p });
+        }
+        else
+            moves.Add({ (uint8_t)from, (uint8_t)to, flag });
+    }
+}
+
+// What checks and pins leave the side to move. A side without a king has no limits.
+struct MoveMasks {
+    int king = NoSquare;
+    Bitboard checkers = 0;
+    Bitboard checkMask = ~0ull; // where other pieces have to land: on the checker or in its way, nowhere in double check
+    Bitboard pinned = 0; // our pieces that may only move along the line to their king
+};
+
+inline MoveMasks ComputeMasks(const GameState& state)
+{
+    MoveMasks masks;
+    const BoardState& board = state.board;
+    int us = state.sideToMove;
+    int them = us ^ 1;
+    int king = masks.king = KingSquare(board, us);
+    if (king == NoSquare)
+        return masks;
+
+    Bitboard occupied = board.Occupied();
+    masks.checkers = AttackersTo(board, king, occupied) & board.Pieces(them);
+    if (masks.checkers)
+        masks.checkMask = PopCount(masks.checkers) > 1 ? 0 : masks.checkers | Attacks::Between(king, LowestSquare(masks.checkers));
+
+    // Enemy sliders that would see the king if a single one of our pieces stepped aside
+    Bitboard straight = board.Pieces(them, PieceType::Rook) | board.Pieces(them, PieceType::Queen);
+    Bitboard diagonal = board.Pieces(them, PieceType::Bishop) | board.Pieces(them, PieceType::Queen);
+    Bitboard snipers = (Attacks::Rook(king, board.Pieces(them)) & straight) | (Attacks::Bishop(king, board.Pieces(them)) & diagonal);
+    while (snipers)
+    {
+        Bitboard blockers = Attacks::Between(king, PopLowest(snipers)) & occupied;
+        if (PopCount(blockers) == 1 && (blockers & board.Pieces(us)))
+            masks.pinned |= blockers;
+    }
+    return masks;
+}
+
+// Legal moves for the side to move, used by the AI, the tools and the board on
+// screen alike. Checks and pins are worked out once and every piece's targets
+// are masked with them, so no move has to be played to test it. With
+// capturesOnly set only captures and queen promotions are generated, for the
+// quiescence search. fromMask limits it to the pieces on those squares.
+inline void GenerateLegalMoves(const GameState& state, MoveList& moves, bool capturesOnly = false, Bitboard fromMask = ~0ull)
+{
+    moves.Clear();
+    const BoardState& board = state.board;
+    int us = state.sideToMove;
+    int them = us ^ 1;
+    Bitboard occupied = board.Occupied();
+    Bitboard enemies = board.Pieces(them);
+    Bitboard targetMask = capturesOnly ? enemies : ~board.Pieces(us);
+    MoveMasks masks = ComputeMasks(state);
+    int king = masks.king;
+
+    // The king may go anywhere that isn't attacked once it has stepped off its square
+    if (king != NoSquare && (fromMask & SquareBit(king)))
+    {
+        Bitboard targets = Attacks::KingAttacks[king] & targetMask;
+        Bitboard without = occupied ^ SquareBit(king);
+        while (targets)
+        {
+            int to = PopLowest(targets);
+            if (!(AttackersTo(board, to, without) & enemies))
+                moves.Add({ (uint8_t)king, (uint8_t)to });
+        }
+    }
+    if (!masks.checkMask)
+        return;
+
+    Bitboard promoRanks = 0xFF000000000000FFull;
+    Bitboard pawns = board.Pieces(us, PieceType::Pawn) & fromMask;
+    while (pawns)
+    {
+        int from = PopLowest(pawns);
+        Bitboard limit = masks.checkMask;
+        if (masks.pinned & SquareBit(from))
+            limit &= Attacks::Line(king, from);
+
+        // The double push is found before masking, it can block a check the single push doesn't
+        Bitboard push = Attacks::PawnPushes[us][from] & ~occupied;
+        Bitboard doublePush = push ? Attacks::PawnDoublePushes[us][from] & ~occupied : 0;
+        Bitboard captures = Attacks::PawnAttacks[us][from] & enemies & limit;
+        push &= limit;
+        if (capturesOnly)
+        {
+            // Promotions change the material balance enough to count as captures here
+            if (push & promoRanks)
+                moves.Add({ (uint8_t)from, (uint8_t)LowestSquare(push), MoveFlag::Promotion, PieceType::Queen });
+            while (captures)
+            {
+                int to = PopLowest(captures);
+                moves.Add({ (uint8_t)from, (uint8_t)to, SquareBit(to) & promoRanks ? MoveFlag::Promotion : MoveFlag::Normal, PieceType::Queen });
+            }
+        }
+        else
+        {
+            AddPawnMoves(moves, from, push, MoveFlag::Normal);
+            AddPawnMoves(moves, from, doublePush & limit, MoveFlag::DoublePush);
+            AddPawnMoves(moves, from, captures, MoveFlag::Normal);
+        }
+
+        // En passant takes a pawn off a square the move doesn't land on, which can
+        // uncover the king sideways, so the position after it is checked directly
+        if (state.epSquare != NoSquare && (Attacks::PawnAttacks[us][from] & SquareBit(state.epSquare)))
+        {
+            Bitboard taken = SquareBit(state.epSquare + (us == White ? -8 : 8));
+            Bitboard after = (occupied ^ SquareBit(from) ^ taken) | SquareBit(state.epSquare);
+            if (king == NoSquare || !(AttackersTo(board, king, after) & enemies & ~taken))
+                moves.Add({ (uint8_t)from, (uint8_t)state.epSquare, MoveFlag::EnPassant });
+        }
+    }
+
+    Bitboard allowed = masks.checkMask & targetMask;
+    for (PieceType t : { PieceType::Knight, PieceType::Bishop, PieceType::Rook, PieceType::Queen, PieceType::King })
+    {
+        Bitboard pieces = board.Pieces(us, t) & fromMask;
+        if (king != NoSquare)
+            pieces &= ~SquareBit(king);
+        while (pieces)
+        {
+            int from = PopLowest(pieces);
+            Bitboard targets = 0;
+            switch (t)
+            {
+            case PieceType::Knight: targets = Attacks::KnightAttacks[from]; break;
+            case PieceType::Bishop: targets = Attacks::Bishop(from, occupied); break;
+            case PieceType::Rook: targets = Attacks::Rook(from, occupied); break;
+            case PieceType::Queen: targets = Attacks::Queen(from, occupied); break;
+            default: targets = Attacks::KingAttacks[from]; break;
+            }
+            targets &= allowed;
+            if (masks.pinned & SquareBit(from))
+                targets &= Attacks::Line(king, from);
+            while (targets)
+                moves.Add({ (uint8_t)from, (uint8_t)PopLowest(targets) });
+        }
+    }
+
+    if (capturesOnly || masks.checkers || king == NoSquare || !(fromMask & SquareBit(king)))
+        return;
+
+    // Castling, the king may not pass through or land in check
+    int y = us == White ? 1 : 8;
+    int kingSide = us == White ? WhiteKingSide : BlackKingSide;
+    int queenSide = us == White ? WhiteQueenSide : BlackQueenSide;
+    if (king != SquareOf(5, y))
+        return;
+    if ((state.castling & kingSide)
+        && !(occupied & (SquareBit(SquareOf(6, y)) | SquareBit(SquareOf(7, y))))
+        && !IsAttacked(board, SquareOf(6, y), them) && !IsAttacked(board, SquareOf(7, y), them))
+        moves.Add({ (uint8_t)king, (uint8_t)SquareOf(7, y), MoveFlag::Castle });
+    if ((state.castling & queenSide)
+        && !(occupied & (SquareBit(SquareOf(2, y)) | SquareBit(SquareOf(3, y)) | SquareBit(SquareOf(4, y))))
+        && !IsAttacked(board, SquareOf(4, y), them) && !IsAttacked(board, SquareOf(3, y), them))
+        moves.Add({ (uint8_t)king, (uint8_t)SquareOf(3, y), MoveFlag::Castle });
+}
+
+// Legal moves of the piece on one square
+inline void GeneratePieceMoves(const GameState& state, int sq, MoveList& moves)
+{
+    GenerateLegalMoves(state, moves, false, SquareBit(sq));
+}
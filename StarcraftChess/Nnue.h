@@ -0,0 +1,574 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "GameState.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NNUE_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang need the instruction set named on each function that uses it,
+// MSVC accepts the intrinsics anywhere
+#if defined(__GNUC__) || defined(__clang__)
+#define NNUE_TARGET(isa) __attribute__((target(isa)))
+#else
+#define NNUE_TARGET(isa)
+#endif
+
+// Efficiently updatable neural network evaluation. The input layer is sparse:
+// a feature per (own king square, piece, square) seen from each side, plus
+// the side's minerals and training queue. Its output, the accumulator, only
+// changes by the weight rows of features that came or went, so the search
+// adds and subtracts a few rows per move instead of running the whole layer.
+// The small layers after it run on int8/int16 with AVX2, SSE4.1 or plain C++
+// picked at runtime.
+//
+// Weights come from a versioned binary file, see Network::Load. Without one
+// the search keeps using the hand-written Evaluate.
+namespace Nnue {
+    // Input features, every index is seen from one side's point of view ("us"),
+    // with the board flipped for black so both sides share the weights
+    const int KingBuckets = 65; // own king square, 64 when the side has no king
+    const int PieceKinds = PieceTypeCount * 2; // ours then theirs for each type
+    const int PieceFeatures = KingBuckets * PieceKinds * 64;
+    const int MineralFeatureBuckets = 32;
+    const int MineralFeatureSize = 20; // minerals per bucket, the last one takes the rest
+    const int QueueFeatureTurns = 8; // turns left are counted up to this
+    const int EconomyFeaturesPerSide = MineralFeatureBuckets + PieceTypeCount * QueueFeatureTurns;
+    const int FeatureCount = PieceFeatures + EconomyFeaturesPerSide * 2;
+    const int MaxActive = 64 + 2 + TrainingQueueSize * 2; // pieces, both banks, both queues
+    static_assert(FeatureCount <= 65536, "feature indices are stored in 16 bits");
+
+    // Layer sizes
+    const int HiddenSize = 128; // accumulator width per side
+    const int L1Inputs = HiddenSize * 2;
+    const int L1Size = 32;
+
+    // Quantisation: activations are clipped to [0, 127], the first layer's sums
+    // are scaled down by 2^WeightShift and the output by OutputDivisor
+    const int ActivationMax = 127;
+    const int WeightShift = 6;
+    const int OutputDivisor = 16;
+    const int MaxEvaluation = 10000; // stays clear of mate scores
+
+    const char Magic[4] = { 'S', 'C', 'N', 'N' };
+    const uint32_t FileVersion = 1;
+
+    // Scalar versions, the reference the SIMD ones have to match
+    inline void AddRowScalar(int16_t* acc, const int16_t* row)
+    {
+        for (int i = 0; i < HiddenSize; i++)
+            acc[i] = (int16_t)(acc[i] + row[i]);
+    }
+
+    inline void SubRowScalar(int16_t* acc, const int16_t* row)
+    {
+        for (int i = 0; i < HiddenSize; i++)
+            acc[i] = (int16_t)(acc[i] - row[i]);
+    }
+
+    inline void ClipScalar(const int16_t* in, uint8_t* out, int count)
+    {
+        for (int i = 0; i < count; i++)
+            out[i] = (uint8_t)std::clamp<int>(in[i], 0, ActivationMax);
+    }
+
+    // out[o] = bias[o] + sum of in[i] * weights[o * inputs + i]
+    inline void AffineScalar(const uint8_t* in, const int8_t* weights, const int32_t* bias, int32_t* out, int inputs, int outputs)
+    {
+        for (int o = 0; o < outputs; o++)
+        {
+            int32_t sum = bias[o];
+            const int8_t* row = weights + o * inputs;
+            for (int i = 0; i < inputs; i++)
+                sum += in[i] * row[i];
+            out[o] = sum;
+        }
+    }
+
+#ifdef NNUE_X86
+    NNUE_TARGET("sse4.1") inline void AddRowSse(int16_t* acc, const int16_t* row)
+    {
+        for (int i = 0; i < HiddenSize; i += 8)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i*)(acc + i));
+            __m128i w = _mm_loadu_si128((const __m128i*)(row + i));
+            _mm_storeu_si128((__m128i*)(acc + i), _mm_add_epi16(a, w));
+        }
+    }
+
+    NNUE_TARGET("sse4.1") inline void SubRowSse(int16_t* acc, const int16_t* row)
+    {
+        for (int i = 0; i < HiddenSize; i += 8)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i*)(acc + i));
+            __m128i w = _mm_loadu_si128((const __m128i*)(row + i));
+            _mm_storeu_si128((__m128i*)(acc + i), _mm_sub_epi16(a, w));
+        }
+    }
+
+    NNUE_TARGET("sse4.1") inline void ClipSse(const int16_t* in, uint8_t* out, int count)
+    {
+        const __m128i max = _mm_set1_epi16(ActivationMax);
+        const __m128i zero = _mm_setzero_si128();
+        for (int i = 0; i < count; i += 16)
+        {
+            __m128i a = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i*)(in + i)), zero), max);
+            __m128i b = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i*)(in + i + 8)), zero), max);
+            _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(a, b));
+        }
+    }
+
+    // Dot product of one input vector with one weight row, summed into four i32 lanes
+    NNUE_TARGET("sse4.1") inline __m128i DotSse(const uint8_t* in, const int8_t* row, int inputs)
+    {
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i sum = _mm_setzero_si128();
+        for (int i = 0; i < inputs; i += 16)
+        {
+            // u8 * i8 pairs into i16, then pairs of those into i32. Activations
+            // stay under 128 so the i16 step can't saturate.
+            __m128i products = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*)(in + i)), _mm_loadu_si128((const __m128i*)(row + i)));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(products, ones));
+        }
+        return sum;
+    }
+
+    NNUE_TARGET("sse4.1") inline void AffineSse(const uint8_t* in, const int8_t* weights, const int32_t* bias, int32_t* out, int inputs, int outputs)
+    {
+        int o = 0;
+        // Four rows at a time so their horizontal sums share the shuffles
+        for (; o + 4 <= outputs; o += 4)
+        {
+            const int8_t* row = weights + o * inputs;
+            __m128i s0 = DotSse(in, row, inputs);
+            __m128i s1 = DotSse(in, row + inputs, inputs);
+            __m128i s2 = DotSse(in, row + 2 * inputs, inputs);
+            __m128i s3 = DotSse(in, row + 3 * inputs, inputs);
+            __m128i sums = _mm_hadd_epi32(_mm_hadd_epi32(s0, s1), _mm_hadd_epi32(s2, s3));
+            _mm_storeu_si128((__m128i*)(out + o), _mm_add_epi32(sums, _mm_loadu_si128((const __m128i*)(bias + o))));
+        }
+        for (; o < outputs; o++)
+        {
+            __m128i sum = DotSse(in, weights + o * inputs, inputs);
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+            out[o] = bias[o] + _mm_cvtsi128_si32(sum);
+        }
+    }
+
+    NNUE_TARGET("avx2") inline void AddRowAvx2(int16_t* acc, const int16_t* row)
+    {
+        for (int i = 0; i < HiddenSize; i += 16)
+        {
+            __m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+            __m256i w = _mm256_loadu_si256((const __m256i*)(row + i));
+            _mm256_storeu_si256((__m256i*)(acc + i), _mm256_add_epi16(a, w));
+        }
+    }
+
+    NNUE_TARGET("avx2") inline void SubRowAvx2(int16_t* acc, const int16_t* row)
+    {
+        for (int i = 0; i < HiddenSize; i += 16)
+        {
+            __m256i a = _mm256_loadu_si256((const __m256i*)(acc + i));
+            __m256i w = _mm256_loadu_si256((const __m256i*)(row + i));
+            _mm256_storeu_si256((__m256i*)(acc + i), _mm256_sub_epi16(a, w));
+        }
+    }
+
+    NNUE_TARGET("avx2") inline void ClipAvx2(const int16_t* in, uint8_t* out, int count)
+    {
+        const __m256i max = _mm256_set1_epi16(ActivationMax);
+        const __m256i zero = _mm256_setzero_si256();
+        for (int i = 0; i < count; i += 32)
+        {
+            __m256i a = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(in + i)), zero), max);
+            __m256i b = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*)(in + i + 16)), zero), max);
+            // packus works per 128 bit lane, the permute puts the halves back in order
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256((__m256i*)(out + i), packed);
+        }
+    }
+
+    NNUE_TARGET("avx2") inline __m256i DotAvx2(const uint8_t* in, const int8_t* row, int inputs)
+    {
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i sum = _mm256_setzero_si256();
+        for (int i = 0; i < inputs; i += 32)
+        {
+            __m256i products = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(in + i)), _mm256_loadu_si256((const __m256i*)(row + i)));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, ones));
+        }
+        return sum;
+    }
+
+    NNUE_TARGET("avx2") inline void AffineAvx2(const uint8_t* in, const int8_t* weights, const int32_t* bias, int32_t* out, int inputs, int outputs)
+    {
+        int o = 0;
+        for (; o + 4 <= outputs; o += 4)
+        {
+            const int8_t* row = weights + o * inputs;
+            __m256i s0 = DotAvx2(in, row, inputs);
+            __m256i s1 = DotAvx2(in, row + inputs, inputs);
+            __m256i s2 = DotAvx2(in, row + 2 * inputs, inputs);
+            __m256i s3 = DotAvx2(in, row + 3 * inputs, inputs);
+            // hadd works per 128 bit lane, the two lanes' partial sums are added last
+            __m256i sums = _mm256_hadd_epi32(_mm256_hadd_epi32(s0, s1), _mm256_hadd_epi32(s2, s3));
+            __m128i total = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+            _mm_storeu_si128((__m128i*)(out + o), _mm_add_epi32(total, _mm_loadu_si128((const __m128i*)(bias + o))));
+        }
+        for (; o < outputs; o++)
+        {
+            __m256i sum = DotAvx2(in, weights + o * inputs, inputs);
+            __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+            out[o] = bias[o] + _mm_cvtsi128_si32(half);
+        }
+    }
+#endif
+
+    enum class SimdLevel {
+        Scalar,
+        Sse41,
+        Avx2
+    };
+
+    inline SimdLevel DetectSimd()
+    {
+#if defined(NNUE_X86) && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return SimdLevel::Avx2;
+        if (__builtin_cpu_supports("sse4.1"))
+            return SimdLevel::Sse41;
+#elif defined(NNUE_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+        __cpuid(info, 1);
+        bool sse41 = info[2] & (1 << 19);
+        // AVX2 also needs the OS to save the upper register halves
+        bool osYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+        if (maxLeaf >= 7 && osYmm)
+        {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5))
+                return SimdLevel::Avx2;
+        }
+        if (sse41)
+            return SimdLevel::Sse41;
+#endif
+        return SimdLevel::Scalar;
+    }
+
+    inline const char* SimdName(SimdLevel level)
+    {
+        switch (level)
+        {
+        case SimdLevel::Avx2: return "avx2";
+        case SimdLevel::Sse41: return "sse4.1";
+        default: return "scalar";
+        }
+    }
+
+    // The kernels the CPU supports, picked once
+    struct Kernels {
+        SimdLevel level = SimdLevel::Scalar;
+        void (*addRow)(int16_t*, const int16_t*) = AddRowScalar;
+        void (*subRow)(int16_t*, const int16_t*) = SubRowScalar;
+        void (*clip)(const int16_t*, uint8_t*, int) = ClipScalar;
+        void (*affine)(const uint8_t*, const int8_t*, const int32_t*, int32_t*, int, int) = AffineScalar;
+
+        explicit Kernels(SimdLevel wanted)
+        {
+            level = std::min(wanted, DetectSimd());
+#ifdef NNUE_X86
+            if (level == SimdLevel::Avx2)
+            {
+                addRow = AddRowAvx2;
+                subRow = SubRowAvx2;
+                clip = ClipAvx2;
+                affine = AffineAvx2;
+            }
+            else if (level == SimdLevel::Sse41)
+            {
+                addRow = AddRowSse;
+                subRow = SubRowSse;
+                clip = ClipSse;
+                affine = AffineSse;
+            }
+#endif
+        }
+    };
+
+    inline int Orient(int perspective, int sq)
+    {
+        return perspective == White ? sq : sq ^ 56;
+    }
+
+    inline int KingBucket(const GameState& state, int perspective)
+    {
+        Bitboard king = state.board.Pieces(perspective, PieceType::King);
+        return king ? Orient(perspective, LowestSquare(king)) : KingBuckets - 1;
+    }
+
+    // Active features of one side's half, sorted so two lists can be diffed in one pass
+    struct FeatureList {
+        uint16_t values[MaxActive];
+        int count = 0;
+    };
+
+    // Mirrors the board top to bottom, the square order black sees
+    inline Bitboard FlipRanks(Bitboard b)
+    {
+        b = ((b >> 8) & 0x00FF00FF00FF00FFull) | ((b & 0x00FF00FF00FF00FFull) << 8);
+        b = ((b >> 16) & 0x0000FFFF0000FFFFull) | ((b & 0x0000FFFF0000FFFFull) << 16);
+        return (b >> 32) | (b << 32);
+    }
+
+    // Written out in index order rather than sorted afterwards, this runs for every evaluation
+    inline void CollectFeatures(const GameState& state, int perspective, FeatureList& list)
+    {
+        list.count = 0;
+        int kingBase = KingBucket(state, perspective) * PieceKinds;
+        for (int t = 0; t < PieceTypeCount; t++)
+            for (int relative = 0; relative < 2; relative++)
+            {
+                int base = (kingBase + t * 2 + relative) * 64;
+                Bitboard b = state.board.Pieces(perspective ^ relative, (PieceType)t);
+                if (perspective == Black)
+                    b = FlipRanks(b);
+                while (b)
+                    list.values[list.count++] = (uint16_t)(base + PopLowest(b));
+            }
+
+        for (int relative = 0; relative < 2; relative++)
+        {
+            int side = perspective ^ relative;
+            int economyBase = PieceFeatures + relative * EconomyFeaturesPerSide;
+            int bucket = std::clamp(state.minerals[side] / MineralFeatureSize, 0, MineralFeatureBuckets - 1);
+            list.values[list.count++] = (uint16_t)(economyBase + bucket);
+
+            // The queue is at most a few orders, an insertion sort keeps them in order
+            int first = list.count;
+            for (int slot = 0; slot < state.trainingCount[side]; slot++)
+            {
+                const TrainingOrder& order = state.training[side][slot];
+                int turns = std::min(order.turnsLeft, QueueFeatureTurns - 1);
+                uint16_t feature = (uint16_t)(economyBase + MineralFeatureBuckets + (int)order.type * QueueFeatureTurns + turns);
+                int i = list.count++;
+                for (; i > first && list.values[i - 1] > feature; i--)
+                    list.values[i] = list.values[i - 1];
+                list.values[i] = feature;
+            }
+        }
+    }
+
+    // The first layer's output for both sides, with the features that produced it
+    struct Accumulator {
+        alignas(32) int16_t values[2][HiddenSize];
+        FeatureList features[2];
+        int kingBucket[2] = {};
+        bool computed = false;
+    };
+
+    class Network {
+    public:
+        std::string error; // why the last Load failed
+
+        Network(SimdLevel wanted = SimdLevel::Avx2) : kernels(wanted)
+        {
+        }
+
+        bool IsLoaded() const
+        {
+            return loaded;
+        }
+
+        SimdLevel Simd() const
+        {
+            return kernels.level;
+        }
+
+        // The file is a header followed by the layers in the order they run,
+        // little-endian, each weight matrix stored one output row at a time:
+        //
+        //   char[4] "SCNN", u32 version, u32 features, u32 hidden, u32 l1
+        //   i16 featureBias[hidden], i16 featureWeights[features][hidden]
+        //   i32 l1Bias[l1], i8 l1Weights[l1][hidden * 2]
+        //   i32 outputBias, i8 outputWeights[l1]
+        //
+        // The sizes have to match this build's, a retrained net with another
+        // shape needs a new version of the code as well.
+        bool Load(const std::string& path)
+        {
+            loaded = false;
+            FILE* file = std::fopen(path.c_str(), "rb");
+            if (!file)
+            {
+                error = "can't open " + path;
+                return false;
+            }
+            char magic[4];
+            uint32_t header[4];
+            bool ok = std::fread(magic, 1, 4, file) == 4 && std::fread(header, sizeof(uint32_t), 4, file) == 4;
+            if (!ok || std::memcmp(magic, Magic, 4) != 0)
+                error = path + " isn't a network file";
+            else if (header[0] != FileVersion)
+                error = path + " is version " + std::to_string(header[0]) + ", expected " + std::to_string(FileVersion);
+            else if (header[1] != FeatureCount || header[2] != HiddenSize || header[3] != L1Size)
+                error = path + " has layer sizes this build doesn't use";
+            else
+            {
+                Allocate();
+                ok = Read(file, featureBias.data(), featureBias.size())
+                    && Read(file, featureWeights.data(), featureWeights.size())
+                    && Read(file, l1Bias.data(), l1Bias.size())
+                    && Read(file, l1Weights.data(), l1Weights.size())
+                    && Read(file, &outputBias, 1)
+                    && Read(file, outputWeights.data(), outputWeights.size());
+                loaded = ok && std::fgetc(file) == EOF;
+                if (!loaded)
+                    error = path + " is cut short or has trailing data";
+            }
+            std::fclose(file);
+            return loaded;
+        }
+
+        // Small random weights, so SelfPlay --check-net can test the kernels without a trained net
+        void Randomize(uint64_t seed)
+        {
+            Allocate();
+            auto next = [&seed](int range) { return (int)(Zobrist::SplitMix(seed) % (2 * range + 1)) - range; };
+            for (int16_t& w : featureBias)
+                w = (int16_t)next(32);
+            for (int16_t& w : featureWeights)
+                w = (int16_t)next(8);
+            for (int32_t& w : l1Bias)
+                w = next(256);
+            for (int8_t& w : l1Weights)
+                w = (int8_t)next(16);
+            outputBias = next(64);
+            for (int8_t& w : outputWeights)
+                w = (int8_t)next(32);
+            loaded = true;
+        }
+
+        // Builds one side's half from scratch
+        void Refresh(const GameState& state, Accumulator& acc, int perspective) const
+        {
+            CollectFeatures(state, perspective, acc.features[perspective]);
+            acc.kingBucket[perspective] = KingBucket(state, perspective);
+            int16_t* values = acc.values[perspective];
+            std::memcpy(values, featureBias.data(), sizeof(acc.values[perspective]));
+            const FeatureList& list = acc.features[perspective];
+            for (int i = 0; i < list.count; i++)
+                kernels.addRow(values, Row(list.values[i]));
+        }
+
+        // Brings acc to state starting from an accumulator of an earlier
+        // position, only the rows of features that differ are touched. A side
+        // whose king moved gets refreshed, every one of its features changed.
+        void Update(const GameState& state, const Accumulator* from, Accumulator& acc) const
+        {
+            for (int perspective = White; perspective <= Black; perspective++)
+            {
+                if (!from || from->kingBucket[perspective] != KingBucket(state, perspective))
+                {
+                    Refresh(state, acc, perspective);
+                    continue;
+                }
+
+                FeatureList& now = acc.features[perspective];
+                const FeatureList& before = from->features[perspective];
+                CollectFeatures(state, perspective, now);
+                acc.kingBucket[perspective] = from->kingBucket[perspective];
+                int16_t* values = acc.values[perspective];
+                if (&acc != from)
+                    std::memcpy(values, from->values[perspective], sizeof(acc.values[perspective]));
+
+                // Both lists are sorted, walk them together
+                int i = 0, j = 0;
+                while (i < before.count || j < now.count)
+                {
+                    if (j == now.count || (i < before.count && before.values[i] < now.values[j]))
+                        kernels.subRow(values, Row(before.values[i++]));
+                    else if (i == before.count || now.values[j] < before.values[i])
+                        kernels.addRow(values, Row(now.values[j++]));
+                    else
+                    {
+                        i++;
+                        j++;
+                    }
+                }
+            }
+            acc.computed = true;
+        }
+
+        // Whether acc holds what a refresh from state would give, for checking the incremental updates
+        bool Matches(const GameState& state, const Accumulator& acc) const
+        {
+            Accumulator fresh;
+            for (int perspective = White; perspective <= Black; perspective++)
+                Refresh(state, fresh, perspective);
+            return std::memcmp(fresh.values, acc.values, sizeof(acc.values)) == 0;
+        }
+
+        // Score of the position acc was built for, from the side to move's point of view
+        int Evaluate(const Accumulator& acc, int sideToMove) const
+        {
+            alignas(32) uint8_t input[L1Inputs];
+            alignas(32) uint8_t hidden[L1Size];
+            int32_t sums[L1Size];
+            kernels.clip(acc.values[sideToMove], input, HiddenSize);
+            kernels.clip(acc.values[sideToMove ^ 1], input + HiddenSize, HiddenSize);
+            kernels.affine(input, l1Weights.data(), l1Bias.data(), sums, L1Inputs, L1Size);
+            for (int i = 0; i < L1Size; i++)
+                hidden[i] = (uint8_t)std::clamp(sums[i] >> WeightShift, 0, ActivationMax);
+            int32_t output;
+            kernels.affine(hidden, outputWeights.data(), &outputBias, &output, L1Size, 1);
+            return std::clamp(output / OutputDivisor, -MaxEvaluation, MaxEvaluation);
+        }
+
+    private:
+        Kernels kernels;
+        bool loaded = false;
+        std::vector<int16_t> featureBias;
+        std::vector<int16_t> featureWeights;
+        std::vector<int32_t> l1Bias;
+        std::vector<int8_t> l1Weights;
+        int32_t outputBias = 0;
+        std::vector<int8_t> outputWeights;
+
+        const int16_t* Row(int feature) const
+        {
+            return featureWeights.data() + (size_t)feature * HiddenSize;
+        }
+
+        void Allocate()
+        {
+            featureBias.assign(HiddenSize, 0);
+            featureWeights.assign((size_t)FeatureCount * HiddenSize, 0);
+            l1Bias.assign(L1Size, 0);
+            l1Weights.assign(L1Size * L1Inputs, 0);
+            outputBias = 0;
+            outputWeights.assign(L1Size, 0);
+        }
+
+        template <typename T>
+        static bool Read(FILE* file, T* data, size_t count)
+        {
+            return std::fread(data, sizeof(T), count, file) == count;
+        }
+    };
+}
@@ -0,0 +1,175 @@
+#pragma once
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "MoveGen.h"
+
+// Opening book: moves known to be good in positions the game reaches often,
+// keyed by GameState::hash. The file is the header below followed by the
+// entries sorted by key, little-endian, so it's memory-mapped and searched
+// in place with no parsing at startup:
+//
+//   char[4] "SCBK", u32 version, u32 entry size, u32 reserved, u64 entry count
+//   BookEntry[count]
+
+struct BookEntry {
+    uint64_t key;
+    uint32_t move; // Move::Encode
+    uint16_t weight; // times the move was played here
+    uint16_t learn; // half points the side that played it scored with it, BookBuilder --update adds new games
+};
+static_assert(sizeof(BookEntry) == 16, "book entries are 16 bytes on disk");
+
+struct BookHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entrySize;
+    uint32_t reserved;
+    uint64_t count;
+};
+static_assert(sizeof(BookHeader) == 24, "the book header is 24 bytes on disk");
+
+class OpeningBook {
+private:
+    MappedFile file;
+    const BookEntry* entries = nullptr;
+    size_t count = 0;
+
+public:
+    static constexpr char Magic[4] = { 'S', 'C', 'B', 'K' };
+    static const uint32_t Version = 1;
+
+    std::string error; // why the last Open failed
+
+    // Maps the book, only the header is looked at here
+    bool Open(const std::string& path)
+    {
+        Close();
+        if (!file.Open(path))
+        {
+            error = "can't open " + path;
+            return false;
+        }
+        BookHeader header;
+        if (file.Size() < sizeof(header))
+        {
+            error = path + " isn't a book file";
+            Close();
+            return false;
+        }
+        std::memcpy(&header, file.Data(), sizeof(header));
+        if (std::memcmp(header.magic, Magic, 4) != 0)
+            error = path + " isn't a book file";
+        else if (header.version != Version || header.entrySize != sizeof(BookEntry))
+            error = path + " is version " + std::to_string(header.version) + ", expected " + std::to_string(Version);
+        else if (header.count != (file.Size() - sizeof(header)) / sizeof(BookEntry) || (file.Size() - sizeof(header)) % sizeof(BookEntry))
+            error = path + " has the wrong size for its entry count";
+        else
+        {
+            entries = (const BookEntry*)(file.Data() + sizeof(header));
+            count = (size_t)header.count;
+            return true;
+        }
+        Close();
+        return false;
+    }
+
+    void Close()
+    {
+        file.Close();
+        entries = nullptr;
+        count = 0;
+    }
+
+    bool IsOpen() const
+    {
+        return entries != nullptr;
+    }
+
+    size_t Size() const
+    {
+        return count;
+    }
+
+    // Every entry, sorted by key
+    std::span<const BookEntry> Entries() const
+    {
+        return { entries, count };
+    }
+
+    // Every entry for a position, by binary search over the sorted keys
+    std::pair<const BookEntry*, const BookEntry*> Probe(uint64_t key) const
+    {
+        auto less = [](const BookEntry& e, uint64_t k) { return e.key < k; };
+        const BookEntry* first = std::lower_bound(entries, entries + count, key, less);
+        const BookEntry* last = first;
+        while (last != entries + count && last->key == key)
+            last++;
+        return { first, last };
+    }
+
+    // Picks a book move for the position, more often the more it was played
+    // and the better it scored. random is any random number. Moves that
+    // aren't legal here, from a hash collision, are left out.
+    bool Pick(const GameState& state, uint64_t random, Move& out) const
+    {
+        if (!IsOpen())
+            return false;
+        auto [first, last] = Probe(state.hash);
+        if (first == last)
+            return false;
+
+        MoveList legal;
+        GenerateLegalMoves(state, legal);
+        Move candidates[MaxMoves];
+        uint64_t weights[MaxMoves];
+        int n = 0;
+        uint64_t total = 0;
+        for (const BookEntry* e = first; e != last && n < MaxMoves; e++)
+        {
+            Move m = Move::Decode(e->move);
+            if (std::find(legal.begin(), legal.end(), m) == legal.end())
+                continue;
+            candidates[n] = m;
+            weights[n] = (uint64_t)e->weight + e->learn;
+            total += weights[n++];
+        }
+        if (total == 0)
+            return false;
+
+        uint64_t r = random % total;
+        for (int i = 0; i < n; i++)
+        {
+            if (r < weights[i])
+            {
+                out = candidates[i];
+                return true;
+            }
+            r -= weights[i];
+        }
+        return false;
+    }
+
+    // Sorts the entries and writes them in the format Open reads, for the builder
+    static bool Write(const std::string& path, std::vector<BookEntry> entries)
+    {
+        std::sort(entries.begin(), entries.end(), [](const BookEntry& a, const BookEntry& b) {
+            return a.key != b.key ? a.key < b.key : a.weight > b.weight;
+        });
+        FILE* out = std::fopen(path.c_str(), "wb");
+        if (!out)
+            return false;
+        BookHeader header = {};
+        std::memcpy(header.magic, Magic, 4);
+        header.version = Version;
+        header.entrySize = sizeof(BookEntry);
+        header.count = entries.size();
+        bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1
+            && std::fwrite(entries.data(), sizeof(BookEntry), entries.size(), out) == entries.size();
+        return std::fclose(out) == 0 && ok;
+    }
+};
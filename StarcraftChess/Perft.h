@@ -0,0 +1,124 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "MoveGen.h"
+
+// Counts the leaf nodes of the legal move tree, used to validate and time
+// move generation against positions with known counts.
+
+// Optional cache of subtree counts keyed by position and depth. Entries are
+// XOR-checked like the transposition table so root split threads can share it.
+class PerftCache {
+private:
+    struct Entry {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> count;
+    };
+
+    std::unique_ptr<Entry[]> entries;
+    uint64_t mask = 0;
+
+    static uint64_t Key(uint64_t hash, int depth)
+    {
+        return hash ^ (0x9E3779B97F4A7C15ull * (uint64_t)(depth + 1));
+    }
+
+public:
+    PerftCache(size_t megabytes)
+    {
+        size_t count = 1;
+        while (count * 2 * sizeof(Entry) <= megabytes * 1024 * 1024)
+            count *= 2;
+        entries.reset(new Entry[count]);
+        mask = count - 1;
+        for (uint64_t i = 0; i <= mask; i++)
+        {
+            entries[i].check = 0;
+            entries[i].count = 0;
+        }
+    }
+
+    bool Probe(uint64_t hash, int depth, uint64_t& count) const
+    {
+        uint64_t key = Key(hash, depth);
+        Entry& e = entries[key & mask];
+        uint64_t c = e.count.load(std::memory_order_relaxed);
+        if ((e.check.load(std::memory_order_relaxed) ^ c) != key)
+            return false;
+        count = c;
+        return true;
+    }
+
+    void Store(uint64_t hash, int depth, uint64_t count)
+    {
+        uint64_t key = Key(hash, depth);
+        Entry& e = entries[key & mask];
+        e.count.store(count, std::memory_order_relaxed);
+        e.check.store(key ^ count, std::memory_order_relaxed);
+    }
+};
+
+// Leaf count of the tree below state. At the last ply the moves are counted
+// in bulk instead of being played. Moves are made and taken back on state, it
+// is left as it was.
+inline uint64_t Perft(GameState& state, int depth, PerftCache* cache = nullptr)
+{
+    if (depth == 0)
+        return 1;
+
+    uint64_t count = 0;
+    if (cache && depth > 1 && cache->Probe(state.hash, depth, count))
+        return count;
+
+    MoveList moves;
+    GenerateLegalMoves(state, moves);
+    if (depth == 1)
+        return moves.Size();
+
+    for (const Move& m : moves)
+    {
+        UndoInfo undo;
+        state.MakeMove(m, undo);
+        count += Perft(state, depth - 1, cache);
+        state.UnmakeMove(m, undo);
+    }
+
+    if (cache)
+        cache->Store(state.hash, depth, count);
+    return count;
+}
+
+struct PerftDivide {
+    Move move;
+    uint64_t nodes;
+};
+
+// Counts every root move's subtree, spreading the root moves over threads
+inline std::vector<PerftDivide> PerftRootSplit(const GameState& state, int depth, int threadCount, PerftCache* cache = nullptr)
+{
+    MoveList moves;
+    GenerateLegalMoves(state, moves);
+    std::vector<PerftDivide> results(moves.Size());
+
+    std::atomic<int> next = 0;
+    auto work = [&]() {
+        GameState position = state; // one copy per thread, moves are made and taken back on it
+        for (int i = next++; i < moves.Size(); i = next++)
+        {
+            UndoInfo undo;
+            position.MakeMove(moves[i], undo);
+            results[i] = { moves[i], Perft(position, depth - 1, cache) };
+            position.UnmakeMove(moves[i], undo);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < threadCount; i++)
+        threads.emplace_back(work);
+    work();
+    for (std::thread& t : threads)
+        t.join();
+    return results;
+}
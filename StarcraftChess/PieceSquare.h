@@ -0,0 +1,226 @@
+#pragma once
+#include <algorithm>
+#include "Bitboard.h"
+
+// Piece values and piece-square tables for the evaluation. Every table has a
+// middlegame and an endgame half that are blended by how much material is
+// left, see Evaluate. The sums are kept in EvalTerms, which GameState updates
+// with every piece and economy change the way it does the hash.
+
+// Centipawn values indexed by PieceType, used for material and move ordering
+const int PieceValues[PieceTypeCount] = { 100, 500, 320, 330, 900, 0 };
+
+// Game phase each piece is worth, a full set of pieces is MaxPhase
+const int PhaseWeights[PieceTypeCount] = { 0, 2, 1, 1, 4, 0 };
+const int MaxPhase = 24;
+
+namespace PieceSquare {
+    // Tables are laid out as the board is seen from white's side, rank 8 on
+    // the first line, and are mirrored for black
+    const int Pawn[2][64] = {
+        {
+              0,   0,   0,   0,   0,   0,   0,   0,
+             60,  60,  60,  60,  60,  60,  60,  60,
+             20,  25,  30,  40,  40,  30,  25,  20,
+              5,  10,  15,  30,  30,  15,  10,   5,
+              0,   5,  10,  25,  25,  10,   5,   0,
+              5,   0,   5,  10,  10,   5,   0,   5,
+              5,  10,  10, -15, -15,  10,  10,   5,
+              0,   0,   0,   0,   0,   0,   0,   0,
+        },
+        {
+              0,   0,   0,   0,   0,   0,   0,   0,
+            110, 110, 110, 110, 110, 110, 110, 110,
+             60,  60,  60,  60,  60,  60,  60,  60,
+             35,  35,  35,  35,  35,  35,  35,  35,
+             20,  20,  20,  20,  20,  20,  20,  20,
+             10,  10,  10,  10,  10,  10,  10,  10,
+              5,   5,   5,   5,   5,   5,   5,   5,
+              0,   0,   0,   0,   0,   0,   0,   0,
+        },
+    };
+
+    const int Rook[2][64] = {
+        {
+              5,   5,   5,  10,  10,   5,   5,   5,
+             20,  25,  25,  25,  25,  25,  25,  20,
+              0,   0,   5,  10,  10,   5,   0,   0,
+             -5,   0,   0,   5,   5,   0,   0,  -5,
+             -5,   0,   0,   5,   5,   0,   0,  -5,
+             -5,   0,   0,   5,   5,   0,   0,  -5,
+            -10,  -5,   0,   5,   5,   0,  -5, -10,
+             -5,   0,   5,  10,  10,   5,   0,  -5,
+        },
+        {
+             10,  10,  10,  10,  10,  10,  10,  10,
+             15,  15,  15,  15,  15,  15,  15,  15,
+              5,   5,   5,   5,   5,   5,   5,   5,
+              0,   0,   0,   0,   0,   0,   0,   0,
+              0,   0,   0,   0,   0,   0,   0,   0,
+              0,   0,   0,   0,   0,   0,   0,   0,
+             -5,  -5,  -5,  -5,  -5,  -5,  -5,  -5,
+             -5,  -5,  -5,  -5,  -5,  -5,  -5,  -5,
+        },
+    };
+
+    const int Knight[2][64] = {
+        {
+            -50, -40, -30, -30, -30, -30, -40, -50,
+            -40, -20,   0,   5,   5,   0, -20, -40,
+            -30,   5,  15,  20,  20,  15,   5, -30,
+            -30,  10,  20,  25,  25,  20,  10, -30,
+            -30,   5,  15,  20,  20,  15,   5, -30,
+            -30,   0,  10,  15,  15,  10,   0, -30,
+            -40, -20,   0,   5,   5,   0, -20, -40,
+            -50, -40, -30, -30, -30, -30, -40, -50,
+        },
+        {
+            -40, -30, -20, -20, -20, -20, -30, -40,
+            -30, -15,   0,   5,   5,   0, -15, -30,
+            -20,   0,  10,  15,  15,  10,   0, -20,
+            -20,   5,  15,  20,  20,  15,   5, -20,
+            -20,   5,  15,  20,  20,  15,   5, -20,
+            -20,   0,  10,  15,  15,  10,   0, -20,
+            -30, -15,   0,   5,   5,   0, -15, -30,
+            -40, -30, -20, -20, -20, -20, -30, -40,
+        },
+    };
+
+    const int Bishop[2][64] = {
+        {
+            -20, -10, -10, -10, -10, -10, -10, -20,
+            -10,   0,   0,   0,   0,   0,   0, -10,
+            -10,   0,   5,  10,  10,   5,   0, -10,
+            -10,   5,   5,  10,  10,   5,   5, -10,
+            -10,   0,  10,  10,  10,  10,   0, -10,
+            -10,  10,  10,  10,  10,  10,  10, -10,
+            -10,   5,   0,   0,   0,   0,   5, -10,
+            -20, -10, -10, -10, -10, -10, -10, -20,
+        },
+        {
+            -15, -10, -10, -10, -10, -10, -10, -15,
+            -10,   0,   0,   0,   0,   0,   0, -10,
+            -10,   0,   5,   5,   5,   5,   0, -10,
+            -10,   0,   5,  10,  10,   5,   0, -10,
+            -10,   0,   5,  10,  10,   5,   0, -10,
+            -10,   0,   5,   5,   5,   5,   0, -10,
+            -10,   0,   0,   0,   0,   0,   0, -10,
+            -15, -10, -10, -10, -10, -10, -10, -15,
+        },
+    };
+
+    const int Queen[2][64] = {
+        {
+            -20, -10, -10,  -5,  -5, -10, -10, -20,
+            -10,   0,   0,   0,   0,   0,   0, -10,
+            -10,   0,   5,   5,   5,   5,   0, -10,
+             -5,   0,   5,   5,   5,   5,   0,  -5,
+             -5,   0,   5,   5,   5,   5,   0,  -5,
+            -10,   5,   5,   5,   5,   5,   0, -10,
+            -10,   0,   5,   0,   0,   0,   0, -10,
+            -20, -10, -10,  -5,  -5, -10, -10, -20,
+        },
+        {
+            -20, -10, -10,  -5,  -5, -10, -10, -20,
+            -10,   0,   5,   5,   5,   5,   0, -10,
+            -10,   5,  10,  10,  10,  10,   5, -10,
+             -5,   5,  10,  15,  15,  10,   5,  -5,
+             -5,   5,  10,  15,  15,  10,   5,  -5,
+            -10,   5,  10,  10,  10,  10,   5, -10,
+            -10,   0,   5,   5,   5,   5,   0, -10,
+            -20, -10, -10,  -5,  -5, -10, -10, -20,
+        },
+    };
+
+    const int King[2][64] = {
+        {
+            -30, -40, -40, -50, -50, -40, -40, -30,
+            -30, -40, -40, -50, -50, -40, -40, -30,
+            -30, -40, -40, -50, -50, -40, -40, -30,
+            -30, -40, -40, -50, -50, -40, -40, -30,
+            -20, -30, -30, -40, -40, -30, -30, -20,
+            -10, -20, -20, -20, -20, -20, -20, -10,
+             15,  15,   0,   0,   0,   0,  15,  15,
+             20,  30,  10,   0,   0,  10,  30,  20,
+        },
+        {
+            -50, -40, -30, -20, -20, -30, -40, -50,
+            -30, -20, -10,   0,   0, -10, -20, -30,
+            -30, -10,  20,  30,  30,  20, -10, -30,
+            -30, -10,  30,  40,  40,  30, -10, -30,
+            -30, -10,  30,  40,  40,  30, -10, -30,
+            -30, -10,  20,  30,  30,  20, -10, -30,
+            -30, -30,   0,   0,   0,   0, -30, -30,
+            -50, -30, -30, -30, -30, -30, -30, -50,
+        },
+    };
+
+    // Indexed by PieceType
+    const int (*const Tables[PieceTypeCount])[64] = { Pawn, Rook, Knight, Bishop, Queen, King };
+
+    // Endgame material, the middlegame uses PieceValues
+    const int EndgameValues[PieceTypeCount] = { 120, 520, 300, 320, 920, 0 };
+
+    // Middlegame (phase 0) or endgame (phase 1) value of a piece on a square, material included
+    inline int Value(int phase, int side, PieceType t, int sq)
+    {
+        int i = side == White ? sq ^ 56 : sq;
+        int material = phase == 0 ? PieceValues[(int)t] : EndgameValues[(int)t];
+        return material + Tables[(int)t][phase][i];
+    }
+}
+
+// Banked minerals and units still in training count for part of what they'll
+// become, so spending on a unit doesn't look like a loss to the search. A
+// bank past a couple of queens' worth adds nothing, so hoarding through a
+// long game can't build a score anywhere near the mate and table range.
+const int MineralsValuedMax = 1000;
+
+inline int MineralsValue(int minerals)
+{
+    return std::clamp(minerals, 0, MineralsValuedMax) * 3 / 4;
+}
+
+inline int TrainingValue(PieceType t, int turnsLeft)
+{
+    return std::max(PieceValues[(int)t] * 3 / 4 - 10 * turnsLeft, 0);
+}
+
+// Mining income is worth what it brings in over the next few turns, enough
+// for the search to want workers on a node without giving up pieces for it
+const int IncomeTurnsValued = 8;
+
+inline int IncomeValue(int income)
+{
+    return MineralsValue(income * IncomeTurnsValued);
+}
+
+// Running sums the evaluation is built from, per side
+struct EvalTerms {
+    int mg[2] = {}; // middlegame material and squares
+    int eg[2] = {}; // endgame material and squares
+    int phase = 0; // sum of PhaseWeights, can pass MaxPhase with trained units
+    int economy[2] = {}; // minerals, mining income and training queue
+
+    void AddPiece(int side, PieceType t, int sq)
+    {
+        mg[side] += PieceSquare::Value(0, side, t, sq);
+        eg[side] += PieceSquare::Value(1, side, t, sq);
+        phase += PhaseWeights[(int)t];
+    }
+
+    void RemovePiece(int side, PieceType t, int sq)
+    {
+        mg[side] -= PieceSquare::Value(0, side, t, sq);
+        eg[side] -= PieceSquare::Value(1, side, t, sq);
+        phase -= PhaseWeights[(int)t];
+    }
+
+    void MovePiece(int side, PieceType t, int from, int to)
+    {
+        mg[side] += PieceSquare::Value(0, side, t, to) - PieceSquare::Value(0, side, t, from);
+        eg[side] += PieceSquare::Value(1, side, t, to) - PieceSquare::Value(1, side, t, from);
+    }
+
+    bool operator==(const EvalTerms&) const = default;
+};
@@ -0,0 +1,661 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "MoveGen.h"
+#include "EndgameTable.h"
+#include "Evaluate.h"
+#include "Nnue.h"
+#include "TranspositionTable.h"
+
+const int MaxSearchPly = 64;
+const int InfiniteScore = 32000;
+
+struct SearchLimits {
+    int depth = MaxSearchPly - 1;
+    uint64_t nodes = 0; // 0 for no limit
+    int timeMs = 0; // 0 for no limit
+};
+
+struct SearchResult {
+    Move best;
+    int score = 0;
+    int depth = 0;
+    uint64_t nodes = 0;
+    int timeMs = 0;
+    uint64_t nps = 0;
+    int threads = 1;
+    int hashFull = 0; // per mille of the transposition table this search has written
+    bool fromBook = false; // taken from the opening book, nothing was searched
+    std::vector<Move> pv;
+};
+
+class SearchThread;
+
+// What every thread taking part in one search shares
+struct SearchShared {
+    TranspositionTable& table;
+    const Nnue::Network* network = nullptr; // evaluates with Evaluate when there's none
+    const Endgame::Tables* tables = nullptr;
+    std::atomic<bool> stop = false;
+    const std::atomic<bool>* stopToken = nullptr; // the owner's own stop flag, see Search::SetStopToken
+    SearchLimits limits;
+    std::chrono::steady_clock::time_point startTime;
+    std::vector<SearchThread*> threads;
+
+    SearchShared(TranspositionTable& tt) : table(tt)
+    {
+    }
+
+    int ElapsedMs() const
+    {
+        return (int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    uint64_t TotalNodes() const;
+};
+
+// One searcher's private state: move stacks, killers and history. Threads
+// only learn from each other through the transposition table (Lazy SMP).
+class SearchThread {
+private:
+    friend class Search;
+    friend struct SearchShared;
+
+    SearchShared& shared;
+    TranspositionTable& table;
+    int index;
+    std::atomic<uint64_t> nodes = 0; // written by this thread only, read by the others for reporting
+    int rootDepth = 0;
+
+    MoveList moveStack[MaxSearchPly + 1];
+    int scoreStack[MaxSearchPly + 1][MaxMoves];
+    std::vector<uint64_t> hashStack; // game history then the current search line
+    Move killers[MaxSearchPly + 1][2];
+    int history[2][64][64] = {};
+    Move pv[MaxSearchPly + 1][MaxSearchPly + 1];
+    int pvLength[MaxSearchPly + 1] = {};
+    int reductions[64][64] = {};
+    Nnue::Accumulator accumulators[MaxSearchPly + 1]; // for the position at each ply of the current line
+
+    // Counts a node and returns whether the search has to stop
+    bool CountNode()
+    {
+        uint64_t n = nodes.load(std::memory_order_relaxed) + 1;
+        nodes.store(n, std::memory_order_relaxed);
+        if ((n & 1023) == 0)
+        {
+            const SearchLimits& limits = shared.limits;
+            if (limits.timeMs > 0 && shared.ElapsedMs() >= limits.timeMs)
+                shared.stop = true;
+            // Only the main thread adds up the node counts of every thread
+            if (index == 0 && limits.nodes > 0 && shared.TotalNodes() >= limits.nodes)
+                shared.stop = true;
+            if (shared.stopToken && shared.stopToken->load(std::memory_order_relaxed))
+                shared.stop = true;
+        }
+        return shared.stop.load(std::memory_order_relaxed);
+    }
+
+    // Static evaluation at a ply of the current line. With a network the
+    // accumulator is brought over from the nearest ply above that has one;
+    // nodes mark theirs stale on entry so only the current line is trusted.
+    int StaticEval(const GameState& state, int ply)
+    {
+        const Nnue::Network* network = shared.network;
+        if (!network)
+            return Evaluate(state);
+
+        const Nnue::Accumulator* from = nullptr;
+        for (int i = ply - 1; i >= 0 && !from; i--)
+            if (accumulators[i].computed)
+                from = &accumulators[i];
+        Nnue::Accumulator& acc = accumulators[ply];
+        network->Update(state, from, acc);
+#ifdef EVAL_CHECK
+        if (!network->Matches(state, acc))
+        {
+            std::fprintf(stderr, "StaticEval: accumulator differs from a refresh\n");
+            std::abort();
+        }
+#endif
+        return network->Evaluate(acc, state.sideToMove);
+    }
+
+    bool IsRepetition(const GameState& state) const
+    {
+        int last = (int)hashStack.size() - 1;
+        for (int i = last - 2; i >= 0 && i >= last - state.halfmoveClock; i -= 2)
+            if (hashStack[i] == state.hash)
+                return true;
+        return false;
+    }
+
+    static bool HasNonPawnMaterial(const GameState& state, int side)
+    {
+        return state.board.Pieces(side) & ~state.board.Pieces(side, PieceType::Pawn) & ~state.board.Pieces(side, PieceType::King);
+    }
+
+    bool IsCapture(const GameState& state, const Move& m) const
+    {
+        return m.flag == MoveFlag::EnPassant || state.board.IsOccupied(m.to);
+    }
+
+    void ScoreMoves(const GameState& state, const MoveList& moves, int* scores, const Move& ttMove, int ply) const
+    {
+        for (int i = 0; i < moves.Size(); i++)
+        {
+            const Move& m = moves[i];
+            int score;
+            if (m == ttMove)
+                score = 2000000;
+            else if (IsCapture(state, m))
+            {
+                int victim = m.flag == MoveFlag::EnPassant ? PieceValues[(int)PieceType::Pawn] : PieceValues[(int)state.board.TypeAt(m.to)];
+                score = 1000000 + victim * 10 - (int)state.board.TypeAt(m.from);
+            }
+            else if (m.flag == MoveFlag::Promotion)
+                score = 900000 + PieceValues[(int)m.promotion];
+            else if (m == killers[ply][0])
+                score = 800001;
+            else if (m == killers[ply][1])
+                score = 800000;
+            else
+                score = history[state.sideToMove][m.from][m.to];
+            scores[i] = score;
+        }
+    }
+
+    // Selection sort step, moves the best remaining move to index i
+    static void PickMove(MoveList& moves, int* scores, int i)
+    {
+        int best = i;
+        for (int j = i + 1; j < moves.Size(); j++)
+            if (scores[j] > scores[best])
+                best = j;
+        std::swap(moves[i], moves[best]);
+        std::swap(scores[i], scores[best]);
+    }
+
+    void UpdatePv(int ply, const Move& m)
+    {
+        pv[ply][ply] = m;
+        for (int i = ply + 1; i < pvLength[ply + 1]; i++)
+            pv[ply][i] = pv[ply + 1][i];
+        pvLength[ply] = pvLength[ply + 1];
+    }
+
+    int Quiescence(GameState& state, int alpha, int beta, int ply)
+    {
+        pvLength[ply] = ply;
+        accumulators[ply].computed = false;
+        if (CountNode())
+            return 0;
+        if (ply >= MaxSearchPly)
+            return StaticEval(state, ply);
+
+        int us = state.sideToMove;
+        if (state.IsEliminated(us))
+            return -MateScore + ply;
+        bool inCheck = InCheck(state, us);
+        int standPat = -InfiniteScore;
+        if (!inCheck)
+        {
+            standPat = StaticEval(state, ply);
+            if (standPat >= beta)
+                return standPat;
+            if (standPat > alpha)
+                alpha = standPat;
+        }
+
+        MoveList& moves = moveStack[ply];
+        int* scores = scoreStack[ply];
+        GenerateLegalMoves(state, moves, !inCheck);
+        ScoreMoves(state, moves, scores, Move(), ply);
+
+        int best = standPat;
+        int legal = 0;
+        for (int i = 0; i < moves.Size(); i++)
+        {
+            PickMove(moves, scores, i);
+            const Move m = moves[i];
+
+            // Delta pruning, skip captures that can't bring the score back up to alpha
+            if (!inCheck && m.flag != MoveFlag::Promotion && m.flag != MoveFlag::EnPassant
+                && standPat + PieceValues[(int)state.board.TypeAt(m.to)] + 200 <= alpha)
+                continue;
+
+            UndoInfo undo;
+            state.MakeMove(m, undo);
+            legal++;
+
+            int score = -Quiescence(state, -beta, -alpha, ply + 1);
+            state.UnmakeMove(m, undo);
+            if (shared.stop)
+                return 0;
+            if (score > best)
+            {
+                best = score;
+                if (score > alpha)
+                {
+                    alpha = score;
+                    if (score >= beta)
+                        break;
+                }
+            }
+        }
+
+        if (inCheck && legal == 0)
+            return -MateScore + ply;
+        return best;
+    }
+
+    int Negamax(GameState& state, int depth, int alpha, int beta, int ply, bool nullAllowed)
+    {
+        if (depth <= 0)
+            return Quiescence(state, alpha, beta, ply);
+
+        pvLength[ply] = ply;
+        accumulators[ply].computed = false;
+        if (CountNode())
+            return 0;
+
+        bool pvNode = beta - alpha > 1;
+        int us = state.sideToMove;
+
+        if (ply > 0)
+        {
+            if (IsRepetition(state) || state.halfmoveClock >= 100)
+                return 0;
+            // Losing everything is scored like being mated, as Match ends the game there
+            if (state.IsEliminated(us))
+                return -MateScore + ply;
+            if (ply >= MaxSearchPly)
+                return StaticEval(state, ply);
+
+            // Small endings are looked up, quicker wins score higher
+            Endgame::ProbeResult probe;
+            if (shared.tables && shared.tables->Probe(state, probe))
+                return probe.wdl * (TableWinScore - ply - probe.distance);
+
+            // A shorter mate has already been found somewhere else
+            alpha = std::max(alpha, -MateScore + ply);
+            beta = std::min(beta, MateScore - ply - 1);
+            if (alpha >= beta)
+                return alpha;
+        }
+
+        TTEntry entry;
+        Move ttMove;
+        if (table.Probe(state.hash, entry))
+        {
+            ttMove = Move::Decode(entry.move);
+            int ttScore = ScoreFromTT(entry.score, ply);
+            if (!pvNode && entry.depth >= depth
+                && (entry.bound == Bound::Exact
+                    || (entry.bound == Bound::Lower && ttScore >= beta)
+                    || (entry.bound == Bound::Upper && ttScore <= alpha)))
+                return ttScore;
+        }
+
+        bool inCheck = InCheck(state, us);
+        int staticEval = inCheck ? -InfiniteScore : StaticEval(state, ply);
+
+        // Reverse futility pruning, too far ahead for a shallow search to change the outcome
+        if (!pvNode && !inCheck && depth <= 3 && staticEval - 120 * depth >= beta)
+            return staticEval;
+
+        // Null move pruning, if passing still fails high a real move will too
+        if (nullAllowed && !pvNode && !inCheck && depth >= 3 && staticEval >= beta && HasNonPawnMaterial(state, us))
+        {
+            int reduction = 2 + depth / 4;
+            UndoInfo undo;
+            state.MakeNullMove(undo);
+            hashStack.push_back(state.hash);
+            int score = -Negamax(state, depth - 1 - reduction, -beta, -beta + 1, ply + 1, false);
+            hashStack.pop_back();
+            state.UnmakeNullMove(undo);
+            if (shared.stop)
+                return 0;
+            if (score >= beta)
+                return score >= DecisiveScore ? beta : score;
+        }
+
+        MoveList& moves = moveStack[ply];
+        int* scores = scoreStack[ply];
+        GenerateLegalMoves(state, moves);
+        ScoreMoves(state, moves, scores, ttMove, ply);
+
+        int originalAlpha = alpha;
+        int bestScore = -InfiniteScore;
+        Move bestMove;
+        int legal = 0;
+        for (int i = 0; i < moves.Size(); i++)
+        {
+            PickMove(moves, scores, i);
+            const Move m = moves[i];
+            bool quiet = !IsCapture(state, m) && m.flag != MoveFlag::Promotion;
+
+            UndoInfo undo;
+            state.MakeMove(m, undo);
+            // The child probes this bucket first thing, start loading it now
+            table.Prefetch(state.hash);
+            legal++;
+
+            bool givesCheck = InCheck(state, us ^ 1);
+            int newDepth = depth - 1;
+            if (givesCheck && ply < rootDepth * 2)
+                newDepth++;
+
+            hashStack.push_back(state.hash);
+            int score;
+            if (legal == 1)
+                score = -Negamax(state, newDepth, -beta, -alpha, ply + 1, true);
+            else
+            {
+                // Late move reductions for quiet moves that ordering put near the back
+                int reduction = 0;
+                if (depth >= 3 && legal > 3 && quiet && !inCheck && !givesCheck)
+                {
+                    reduction = reductions[std::min(depth, 63)][std::min(legal, 63)];
+                    if (pvNode)
+                        reduction--;
+                    if (m == killers[ply][0] || m == killers[ply][1])
+                        reduction--;
+                    reduction = std::clamp(reduction, 0, newDepth - 1);
+                }
+
+                score = -Negamax(state, newDepth - reduction, -alpha - 1, -alpha, ply + 1, true);
+                if (score > alpha && reduction > 0)
+                    score = -Negamax(state, newDepth, -alpha - 1, -alpha, ply + 1, true);
+                if (score > alpha && score < beta)
+                    score = -Negamax(state, newDepth, -beta, -alpha, ply + 1, true);
+            }
+            hashStack.pop_back();
+            state.UnmakeMove(m, undo);
+
+            if (shared.stop)
+                return 0;
+
+            if (score > bestScore)
+            {
+                bestScore = score;
+                bestMove = m;
+                if (score > alpha)
+                {
+                    alpha = score;
+                    UpdatePv(ply, m);
+                    if (score >= beta)
+                    {
+                        if (quiet)
+                        {
+                            if (!(killers[ply][0] == m))
+                            {
+                                killers[ply][1] = killers[ply][0];
+                                killers[ply][0] = m;
+                            }
+                            history[us][m.from][m.to] += depth * depth;
+                            if (history[us][m.from][m.to] > 700000)
+                                for (auto& from : history[us])
+                                    for (int& h : from)
+                                        h /= 2;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (legal == 0)
+        {
+            if (inCheck)
+                return -MateScore + ply;
+            // Stuck without being in check isn't stalemate here, the side passes its turn
+            UndoInfo undo;
+            state.MakeNullMove(undo);
+            hashStack.push_back(state.hash);
+            bestScore = -Negamax(state, depth - 1, -beta, -alpha, ply + 1, false);
+            hashStack.pop_back();
+            state.UnmakeNullMove(undo);
+            if (shared.stop)
+                return 0;
+        }
+
+        Bound bound = bestScore >= beta ? Bound::Lower : (bestScore > originalAlpha ? Bound::Exact : Bound::Upper);
+        table.Store(state.hash, bestMove.Encode(), ScoreToTT(bestScore, ply), depth, bound);
+        return bestScore;
+    }
+
+    // Helper threads skip some depths so they don't all search the same tree in step
+    bool SkipDepth(int depth) const
+    {
+        static const int SkipSize[20] = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+        static const int SkipPhase[20] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+        if (index == 0)
+            return false;
+        int i = (index - 1) % 20;
+        return ((depth + SkipPhase[i]) / SkipSize[i]) % 2 != 0;
+    }
+
+    SearchResult IterativeDeepening(const GameState& root, const std::vector<uint64_t>& gameHistory, const std::function<void(const SearchResult&)>& onIteration)
+    {
+        SearchResult result;
+        const SearchLimits& limits = shared.limits;
+        bool mainThread = index == 0;
+
+        hashStack = gameHistory;
+        hashStack.push_back(root.hash);
+        GameState position = root; // the search makes and takes back moves on its own copy
+
+        int score = 0;
+        for (rootDepth = 1; rootDepth <= limits.depth; rootDepth++)
+        {
+            if (SkipDepth(rootDepth))
+                continue;
+
+            int delta = 30;
+            int alpha = -InfiniteScore;
+            int beta = InfiniteScore;
+            if (rootDepth >= 5)
+            {
+                alpha = std::max(score - delta, -InfiniteScore);
+                beta = std::min(score + delta, InfiniteScore);
+            }
+
+            // Aspiration window, widened on whichever side the score fell out of
+            int iterationScore;
+            while (true)
+            {
+                iterationScore = Negamax(position, rootDepth, alpha, beta, 0, false);
+                if (shared.stop)
+                    break;
+                if (iterationScore <= alpha)
+                    alpha = std::max(iterationScore - delta, -InfiniteScore);
+                else if (iterationScore >= beta)
+                    beta = std::min(iterationScore + delta, InfiniteScore);
+                else
+                    break;
+                delta *= 2;
+            }
+
+            if (shared.stop)
+            {
+                // Root moves are only taken into the pv once fully searched, so a
+                // move that beat the previous best before the cut off is still good
+                if (pvLength[0] > 0)
+                {
+                    result.best = pv[0][0];
+                    result.pv.assign(pv[0], pv[0] + pvLength[0]);
+                }
+                break;
+            }
+
+            score = iterationScore;
+            if (pvLength[0] > 0)
+            {
+                result.best = pv[0][0];
+                result.pv.assign(pv[0], pv[0] + pvLength[0]);
+            }
+            result.score = score;
+            result.depth = rootDepth;
+
+            if (!mainThread)
+                continue;
+
+            result.nodes = shared.TotalNodes();
+            result.timeMs = shared.ElapsedMs();
+            result.threads = (int)shared.threads.size();
+            result.nps = result.nodes * 1000 / std::max(result.timeMs, 1);
+            result.hashFull = table.HashFull();
+            if (onIteration)
+                onIteration(result);
+
+            // The next iteration takes longer than all the earlier ones together
+            if (limits.timeMs > 0 && result.timeMs * 2 > limits.timeMs)
+                break;
+            if (std::abs(score) >= MateScore - MaxMatePly && rootDepth > MateScore - std::abs(score))
+                break;
+        }
+        return result;
+    }
+
+public:
+    SearchThread(SearchShared& s, int threadIndex) : shared(s), table(s.table), index(threadIndex)
+    {
+        for (int d = 1; d < 64; d++)
+            for (int m = 1; m < 64; m++)
+                reductions[d][m] = (int)(0.75 + std::log(d) * std::log(m) / 2.25);
+    }
+
+    // Forgets the killers and fades the history before a new search
+    void Prepare()
+    {
+        nodes = 0;
+        for (auto& k : killers)
+            k[0] = k[1] = Move();
+        for (auto& side : history)
+            for (auto& from : side)
+                for (int& h : from)
+                    h /= 8;
+    }
+};
+
+inline uint64_t SearchShared::TotalNodes() const
+{
+    uint64_t total = 0;
+    for (const SearchThread* t : threads)
+        total += t->nodes.load(std::memory_order_relaxed);
+    return total;
+}
+
+// Iterative deepening negamax with principal variation search, aspiration
+// windows, null move pruning and late move reductions. Positions are cached
+// in the shared transposition table.
+//
+// With more than one thread it runs Lazy SMP: every helper searches the same
+// root at staggered depths with its own history, and they help each other
+// only through the transposition table. The main thread's result is returned.
+class Search {
+private:
+    SearchShared shared;
+    std::vector<std::unique_ptr<SearchThread>> threads;
+
+public:
+    // Called after every finished iteration of the main thread with the best line so far
+    std::function<void(const SearchResult&)> onIteration;
+
+    Search(TranspositionTable& tt, int threadCount = 1) : shared(tt)
+    {
+        SetThreads(threadCount);
+    }
+
+    // Evaluates with the network from now on, nullptr goes back to Evaluate.
+    // Not to be called while a search is running.
+    void SetNetwork(const Nnue::Network* network)
+    {
+        shared.network = network && network->IsLoaded() ? network : nullptr;
+    }
+
+    // Looks up endings in the tables from now on, nullptr to stop.
+    // Not to be called while a search is running.
+    void SetTables(const Endgame::Tables* tables)
+    {
+        shared.tables = tables && tables->MaxPieces() > 0 ? tables : nullptr;
+    }
+
+    // Not to be called while a search is running
+    void SetThreads(int count)
+    {
+        count = std::max(count, 1);
+        threads.clear();
+        shared.threads.clear();
+        for (int i = 0; i < count; i++)
+        {
+            threads.push_back(std::make_unique<SearchThread>(shared, i));
+            shared.threads.push_back(threads.back().get());
+        }
+    }
+
+    int Threads() const
+    {
+        return (int)threads.size();
+    }
+
+    // A flag of the owner's that stops searches too. Unlike Stop it's looked at
+    // when a search starts, so setting it just before Think isn't lost.
+    // Not to be called while a search is running.
+    void SetStopToken(const std::atomic<bool>* token)
+    {
+        shared.stopToken = token;
+    }
+
+    // Safe to call from another thread, the search returns its best move so far
+    void Stop()
+    {
+        shared.stop = true;
+    }
+
+    // Searches until the depth, node or time limit runs out. history holds the
+    // hashes of the positions played before root, for repetition detection.
+    SearchResult Think(const GameState& root, const SearchLimits& searchLimits, const std::vector<uint64_t>& gameHistory = {})
+    {
+        shared.limits = searchLimits;
+        shared.startTime = std::chrono::steady_clock::now();
+        shared.stop = shared.stopToken && shared.stopToken->load();
+        shared.table.NewSearch();
+        for (auto& t : threads)
+            t->Prepare();
+
+        std::vector<std::thread> helpers;
+        for (size_t i = 1; i < threads.size(); i++)
+            helpers.emplace_back([this, i, &root, &gameHistory]() {
+                threads[i]->IterativeDeepening(root, gameHistory, nullptr);
+            });
+
+        SearchResult result = threads[0]->IterativeDeepening(root, gameHistory, onIteration);
+        shared.stop = true;
+        for (std::thread& t : helpers)
+            t.join();
+
+        // Make sure there's always a move to play if one exists
+        if (result.best.IsNull())
+        {
+            MoveList moves;
+            GenerateLegalMoves(root, moves);
+            if (!moves.Empty())
+                result.best = moves[0];
+        }
+
+        result.nodes = shared.TotalNodes();
+        result.timeMs = shared.ElapsedMs();
+        result.threads = Threads();
+        result.nps = result.nodes * 1000 / std::max(result.timeMs, 1);
+        result.hashFull = shared.table.HashFull();
+        return result;
+    }
+};
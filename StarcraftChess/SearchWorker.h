@@ -0,0 +1,162 @@
+#pragma once
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+#include "OpeningBook.h"
+#include "Search.h"
+#include "SpscQueue.h"
+
+struct SearchRequest {
+    int id = 0;
+    GameState state;
+    SearchLimits limits;
+    std::vector<uint64_t> history;
+    bool newGame = false; // clear the transposition table first
+    int threads = 0; // search threads to use from now on, 0 keeps the current count
+};
+
+// Sent back while the worker thinks, finished is set on the last one for a request
+struct SearchProgress {
+    int id = 0;
+    bool finished = false;
+    SearchResult result;
+};
+
+// Runs the AI search on its own thread so the render loop never waits on it.
+// The game thread submits requests and polls for progress through lock-free
+// single-producer/single-consumer queues.
+class SearchWorker {
+private:
+    TranspositionTable& table;
+    Search search;
+    const OpeningBook* book = nullptr;
+    std::mt19937_64 random = std::mt19937_64(std::random_device()());
+    std::thread thread;
+
+    SpscQueue<SearchRequest, 4> requests;
+    SpscQueue<SearchProgress, 64> progress;
+    std::atomic<int> pending = 0; // requests waiting, the worker sleeps on this
+    std::atomic<int> cancelledUpTo = 0;
+    std::atomic<bool> cancelled = false; // the search's stop token, set by Cancel and cleared per request
+    std::atomic<bool> quit = false;
+    int lastId = 0;
+    int currentId = 0;
+
+    void Run()
+    {
+        while (true)
+        {
+            pending.wait(0);
+            if (quit)
+                return;
+
+            SearchRequest request;
+            if (!requests.TryPop(request))
+                continue;
+            pending.fetch_sub(1);
+            // Cleared before looking at cancelledUpTo, so a Cancel from here on is
+            // either seen below or leaves the token set for the search to see
+            cancelled = false;
+            if (request.id <= cancelledUpTo || quit)
+                continue;
+
+            if (request.newGame)
+                table.Clear();
+            if (request.threads > 0 && request.threads != search.Threads())
+                search.SetThreads(request.threads);
+            currentId = request.id;
+            SearchProgress done;
+            done.id = request.id;
+            done.finished = true;
+            // Known openings are played straight from the book without searching
+            Move bookMove;
+            if (book && book->Pick(request.state, random(), bookMove))
+            {
+                done.result.best = bookMove;
+                done.result.fromBook = true;
+            }
+            else
+                done.result = search.Think(request.state, request.limits, request.history);
+
+            // The final result must get through, wait for the game thread to drain the queue
+            while (!progress.TryPush(done))
+            {
+                if (quit)
+                    return;
+                std::this_thread::yield();
+            }
+        }
+    }
+
+public:
+    SearchWorker(TranspositionTable& tt, int threads = 1) : table(tt), search(tt, threads)
+    {
+        search.onIteration = [this](const SearchResult& result) {
+            SearchProgress p;
+            p.id = currentId;
+            p.result = result;
+            // Progress is only informative, drop it if the game thread is behind
+            progress.TryPush(p);
+        };
+        search.SetStopToken(&cancelled);
+        thread = std::thread(&SearchWorker::Run, this);
+    }
+
+    ~SearchWorker()
+    {
+        quit = true;
+        cancelled = true;
+        search.Stop();
+        pending.fetch_add(1);
+        pending.notify_one();
+        thread.join();
+    }
+
+    // Has the search evaluate with the network, before the first Submit
+    void SetNetwork(const Nnue::Network* network)
+    {
+        search.SetNetwork(network);
+    }
+
+    // Has the search look up endings in the tables, before the first Submit
+    void SetTables(const Endgame::Tables* tables)
+    {
+        search.SetTables(tables);
+    }
+
+    // Plays moves from the book while it has them, before the first Submit
+    void SetBook(const OpeningBook* openingBook)
+    {
+        book = openingBook && openingBook->IsOpen() ? openingBook : nullptr;
+    }
+
+    // Queues a search and returns its id, or 0 if too many are already queued
+    int Submit(SearchRequest request)
+    {
+        request.id = ++lastId;
+        if (!requests.TryPush(std::move(request)))
+            return 0;
+        pending.fetch_add(1);
+        pending.notify_one();
+        return lastId;
+    }
+
+    // Drops every request submitted so far and stops the one being searched,
+    // nothing from them is reported afterwards
+    void Cancel()
+    {
+        cancelledUpTo = lastId;
+        cancelled = true;
+        search.Stop();
+    }
+
+    // Next progress report, anything from cancelled requests is skipped
+    bool Poll(SearchProgress& out)
+    {
+        while (progress.TryPop(out))
+            if (out.id > cancelledUpTo)
+                return true;
+        return false;
+    }
+};
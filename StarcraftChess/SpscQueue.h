@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Fixed-size lock-free queue for exactly one producer thread and one consumer
+// thread. Push and pop never block; they fail when the queue is full or empty.
+template <typename T, size_t Capacity>
+class SpscQueue {
+private:
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    T items[Capacity];
+    // Kept on separate cache lines so the two threads don't fight over one
+    alignas(64) std::atomic<size_t> head = 0; // next slot to read, owned by the consumer
+    alignas(64) std::atomic<size_t> tail = 0; // next slot to write, owned by the producer
+
+public:
+    bool TryPush(T item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity)
+            return false;
+        items[t & (Capacity - 1)] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& out)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        out = std::move(items[h & (Capacity - 1)]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called from a thread other than the consumer
+    bool Empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
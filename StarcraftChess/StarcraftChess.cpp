@@ -1,18 +1,283 @@
 #include <iostream>
 #include "include/raylib-cpp.hpp"
+#include "include/rlgl.h"
+#include <cstring>
 #include <map>
+#include <unordered_map>
 #define RLIGHTS_IMPLEMENTATION
 #include "rlights.h"
 #include <functional>
+#include "Match.h"
+#include "Attacks.h"
+#include "SearchWorker.h"
+#include "MeshCache.h"
 
 #pragma comment (lib, "lib/raylibdll.lib")
 
 #pragma region Resources Class
+// Every model the game draws. The piece models come first in PieceType order
+// so a piece's type is its model's index.
+enum class ModelId : uint8_t {
+    Pawn,
+    Rook,
+    Knight,
+    Bishop,
+    Queen,
+    King,
+    Board,
+    Selected,
+    Mineral1,
+    Mineral2,
+    Count
+};
+
+const char* const ModelFiles[(int)ModelId::Count] = { "pawn", "rook", "knight", "bishop", "queen", "king", "board", "selected",
+    "mineral_variation_1", "mineral_variation_2" };
+
+// Baked models keep normals and texture coordinates as 16-bit integers
+const uint32_t MeshCacheFlags = MeshCache::QuantizedNormals | MeshCache::QuantizedTexcoords;
+
+// Assets other than models are registered by kind and name and get an id
+// the first time they're asked for. The id is an index, so anything held
+// for a while keeps the id rather than the name.
+typedef uint32_t AssetId;
+const AssetId NoAsset = UINT32_MAX;
+
+enum class AssetType : uint8_t {
+    Texture,
+    Font,
+    Shader
+};
+
+const char* const AssetTypeNames[] = { "texture", "font", "shader" };
+
+// Action bar icons for each PieceType, "<name>_Icon" or "<name>_Black_Icon"
+const char* const UnitIconNames[] = { "Pawn", "Rook", "Knight", "Bishop", "Queen", "King" };
+
+// Bytes an asset holds in main memory and on the GPU, as far as raylib lets us know
+struct AssetMemory {
+    size_t cpu = 0;
+    size_t gpu = 0;
+};
+
 class Resources {
 private:
-    std::map<std::string, Model> cachedModels;
+    // One registered asset, loaded while something holds a reference to it
+    struct Asset {
+        AssetType type;
+        std::string name;
+        int refs = 0;
+        Texture2D texture = {};
+        Font font = {};
+        Shader shader = {};
+        AssetMemory memory;
+    };
+
+    Model models[(int)ModelId::Count] = {}; // filled by LoadModels, indexed by ModelId
+    AssetMemory modelMemory[(int)ModelId::Count];
+    std::unordered_map<std::string, AssetId> assetIds; // "kind:name" to id
+    std::vector<Asset> assets; // indexed by AssetId, entries stay once interned
     std::string assetPath;
     Shader outlineShader;
+
+    void Load(Asset& a)
+    {
+        switch (a.type)
+        {
+        case AssetType::Texture:
+            a.texture = LoadTexture((assetPath + "/textures/" + a.name + ".png").c_str());
+            a.memory.gpu = GetPixelDataSize(a.texture.width, a.texture.height, a.texture.format);
+            break;
+        case AssetType::Font:
+        {
+            a.font = LoadFont((assetPath + "/fonts/" + a.name + ".ttf").c_str());
+            a.memory.gpu = GetPixelDataSize(a.font.texture.width, a.font.texture.height, a.font.texture.format);
+            a.memory.cpu = a.font.glyphCount * (sizeof(GlyphInfo) + sizeof(Rectangle));
+            for (int i = 0; i < a.font.glyphCount; i++)
+                a.memory.cpu += GetPixelDataSize(a.font.glyphs[i].image.width, a.font.glyphs[i].image.height, a.font.glyphs[i].image.format);
+            break;
+        }
+        case AssetType::Shader:
+        {
+            // Registered as "vs|fs", either may be empty for raylib's default
+            size_t split = a.name.find('|');
+            std::string vs = a.name.substr(0, split);
+            std::string fs = a.name.substr(split + 1);
+            std::string vsPath = assetPath + "/shaders/" + vs + ".vs";
+            std::string fsPath = assetPath + "/shaders/" + fs + ".fs";
+            a.shader = LoadShader(vs.size() > 0 ? vsPath.c_str() : nullptr, fs.size() > 0 ? fsPath.c_str() : nullptr);
+            a.memory.cpu = 32 * sizeof(int); // the location table, the program itself is the driver's business
+            break;
+        }
+        }
+    }
+
+    void Unload(Asset& a)
+    {
+        switch (a.type)
+        {
+        case AssetType::Texture: UnloadTexture(a.texture); a.texture = {}; break;
+        case AssetType::Font: UnloadFont(a.font); a.font = {}; break;
+        case AssetType::Shader: UnloadShader(a.shader); a.shader = {}; break;
+        }
+        a.memory = AssetMemory();
+    }
+
+    static AssetMemory ModelMemory(const Model& m)
+    {
+        AssetMemory memory;
+        for (int i = 0; i < m.meshCount; i++)
+        {
+            const Mesh& mesh = m.meshes[i];
+            size_t vertexBytes = (size_t)mesh.vertexCount * (mesh.vertices ? 3 * sizeof(float) : 0)
+                + (size_t)mesh.vertexCount * (mesh.texcoords ? 2 * sizeof(float) : 0)
+                + (size_t)mesh.vertexCount * (mesh.normals ? 3 * sizeof(float) : 0)
+                + (size_t)mesh.vertexCount * (mesh.colors ? 4 : 0)
+                + (size_t)mesh.vertexCount * (mesh.tangents ? 4 * sizeof(float) : 0)
+                + (size_t)mesh.triangleCount * (mesh.indices ? 3 * sizeof(unsigned short) : 0);
+            // raylib keeps its copy of the arrays after uploading them
+            memory.cpu += vertexBytes;
+            memory.gpu += vertexBytes;
+        }
+        return memory;
+    }
+
+    // Loads a model from its baked cache, baking it from the .obj first when
+    // the cache is missing or the sources changed since
+    Model LoadModelCached(const std::string& name, AssetMemory& memory)
+    {
+        std::string objPath = assetPath + "/models/" + name + ".obj";
+        std::string cachePath = assetPath + "/models/cache/" + name + MeshCache::FileExtension;
+        uint64_t hash;
+        if (MeshCache::HashSources(objPath, hash))
+        {
+            MeshCache::File cache;
+            std::string error;
+            if (cache.Open(cachePath, hash, MeshCacheFlags, error))
+                return UploadBaked(cache, memory);
+            if (std::filesystem::exists(cachePath))
+                TraceLog(LOG_INFO, "MODELS: %s, baking it again", error.c_str());
+            Model model = LoadModel(objPath.c_str());
+            memory = ModelMemory(model);
+            if (!Bake(model, cachePath, hash, error))
+                TraceLog(LOG_WARNING, "MODELS: %s", error.c_str());
+            return model;
+        }
+        Model model = LoadModel(objPath.c_str());
+        memory = ModelMemory(model);
+        return model;
+    }
+
+    // Writes what the OBJ loader made of a model to the cache. Only what the
+    // game's models use is kept: positions, normals, texture coordinates and
+    // a diffuse colour per material.
+    static bool Bake(const Model& model, const std::string& path, uint64_t hash, std::string& error)
+    {
+        std::vector<MeshCache::SourceMesh> meshes;
+        std::vector<MeshCache::MaterialRecord> materials;
+        for (int i = 0; i < model.materialCount; i++)
+        {
+            const MaterialMap& diffuse = model.materials[i].maps[MATERIAL_MAP_DIFFUSE];
+            if (diffuse.texture.id != rlGetTextureIdDefault())
+            {
+                error = path + ": textured materials aren't baked";
+                return false;
+            }
+            materials.push_back({ { diffuse.color.r, diffuse.color.g, diffuse.color.b, diffuse.color.a } });
+        }
+        for (int i = 0; i < model.meshCount; i++)
+        {
+            const Mesh& mesh = model.meshes[i];
+            if (!mesh.vertices || mesh.colors || mesh.boneIds)
+            {
+                error = path + ": vertex colours and skinning aren't baked";
+                return false;
+            }
+            MeshCache::SourceMesh source;
+            source.positions = mesh.vertices;
+            source.normals = mesh.normals;
+            source.texcoords = mesh.texcoords;
+            source.indices = mesh.indices;
+            source.vertexCount = (uint32_t)mesh.vertexCount;
+            source.indexCount = mesh.indices ? (uint32_t)mesh.triangleCount * 3 : 0;
+            source.material = (uint32_t)model.meshMaterial[i];
+            meshes.push_back(source);
+        }
+        return MeshCache::Write(path, hash, MeshCacheFlags, meshes, materials, error);
+    }
+
+    // Builds a model straight from a mapped cache: each mesh's interleaved
+    // vertices go to the GPU as one buffer, and nothing but the indices stays
+    // in main memory
+    static Model UploadBaked(const MeshCache::File& cache, AssetMemory& memory)
+    {
+        Model model = {};
+        model.transform = MatrixIdentity();
+        model.meshCount = cache.MeshCount();
+        model.meshes = (Mesh*)MemAlloc(model.meshCount * sizeof(Mesh));
+        model.meshMaterial = (int*)MemAlloc(model.meshCount * sizeof(int));
+        model.materialCount = std::max(cache.MaterialCount(), 1);
+        model.materials = (Material*)MemAlloc(model.materialCount * sizeof(Material));
+        for (int i = 0; i < model.materialCount; i++)
+        {
+            model.materials[i] = LoadMaterialDefault();
+            if (i < cache.MaterialCount())
+            {
+                const uint8_t* c = cache.Material(i).diffuse;
+                model.materials[i].maps[MATERIAL_MAP_DIFFUSE].color = { c[0], c[1], c[2], c[3] };
+            }
+        }
+        memory = AssetMemory();
+        for (int i = 0; i < model.meshCount; i++)
+        {
+            const MeshCache::MeshRecord& record = cache.Mesh(i);
+            model.meshMaterial[i] = (int)record.material;
+            UploadBakedMesh(cache, i, model.meshes[i]);
+            size_t indexBytes = (size_t)record.indexCount * sizeof(unsigned short);
+            memory.cpu += indexBytes;
+            memory.gpu += (size_t)record.vertexCount * MeshCache::VertexStride(record.flags) + indexBytes;
+        }
+        return model;
+    }
+
+    static void UploadBakedMesh(const MeshCache::File& cache, int i, Mesh& mesh)
+    {
+        // raylib's attribute locations and buffer slots (rlgl binds the
+        // attributes by name, UnloadMesh frees every slot and the indices)
+        const int PositionLocation = 0, TexcoordLocation = 1, NormalLocation = 2, ColorLocation = 3;
+        const int VertexBufferSlots = 7, IndexBufferSlot = 6;
+        const int GlShort = 0x1402, GlUnsignedShort = 0x1403;
+
+        const MeshCache::MeshRecord& record = cache.Mesh(i);
+        int stride = (int)MeshCache::VertexStride(record.flags);
+        mesh.vertexCount = (int)record.vertexCount;
+        mesh.triangleCount = (int)record.indexCount / 3;
+        // DrawMesh only draws indexed when the mesh has indices on this side too
+        mesh.indices = (unsigned short*)MemAlloc((int)(record.indexCount * sizeof(unsigned short)));
+        std::memcpy(mesh.indices, cache.Indices(i), record.indexCount * sizeof(unsigned short));
+        mesh.vboId = (unsigned int*)MemAlloc(VertexBufferSlots * sizeof(unsigned int));
+
+        mesh.vaoId = rlLoadVertexArray();
+        rlEnableVertexArray(mesh.vaoId);
+        mesh.vboId[0] = rlLoadVertexBuffer(cache.Vertices(i), (int)record.vertexCount * stride, false);
+        rlSetVertexAttribute(PositionLocation, 3, RL_FLOAT, false, stride, (void*)0);
+        rlEnableVertexAttribute(PositionLocation);
+        bool quantized = record.flags & MeshCache::QuantizedNormals;
+        rlSetVertexAttribute(NormalLocation, 3, quantized ? GlShort : RL_FLOAT, quantized, stride,
+            (void*)(uintptr_t)MeshCache::NormalOffset(record.flags));
+        rlEnableVertexAttribute(NormalLocation);
+        quantized = record.flags & MeshCache::QuantizedTexcoords;
+        rlSetVertexAttribute(TexcoordLocation, 2, quantized ? GlUnsignedShort : RL_FLOAT, quantized, stride,
+            (void*)(uintptr_t)MeshCache::TexcoordOffset(record.flags));
+        rlEnableVertexAttribute(TexcoordLocation);
+        // No colours, shaders that want them get white as UploadMesh does
+        float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        rlSetVertexAttributeDefault(ColorLocation, white, SHADER_ATTRIB_VEC4, 4);
+        rlDisableVertexAttribute(ColorLocation);
+        mesh.vboId[IndexBufferSlot] = rlLoadVertexBufferElement(cache.Indices(i), (int)(record.indexCount * sizeof(unsigned short)), false);
+        rlDisableVertexArray();
+    }
+
 public:
     Resources()
     {
@@ -28,40 +293,128 @@ public:
         outlineShader = s;
     }
 
-    ~Resources()
+    // Frees everything on the GPU, to be called while the window and its GL
+    // context are still there. References held afterwards are dead, Release
+    // ignores them.
+    void UnloadAll()
     {
-        for (auto pair : cachedModels)
+        for (Model& m : models)
         {
-            UnloadModel(pair.second);
+            if (m.meshCount > 0)
+                UnloadModel(m);
+            m = Model();
         }
-        cachedModels.clear();
+        for (Asset& a : assets)
+            if (a.refs > 0)
+            {
+                Unload(a);
+                a.refs = 0;
+            }
+    }
+
+    // The instance is global and goes after CloseWindow, by then UnloadAll has
+    // normally run and there's nothing left to do
+    ~Resources()
+    {
+        UnloadAll();
+    }
+
+    // The id for an asset, registering it without loading it
+    AssetId Intern(AssetType type, const std::string& name)
+    {
+        auto [it, added] = assetIds.try_emplace(std::string(AssetTypeNames[(int)type]) + ":" + name, (AssetId)assets.size());
+        if (added)
+            assets.push_back({ type, name });
+        return it->second;
+    }
+
+    // Takes a reference to an asset, loading it if nothing held one
+    AssetId Acquire(AssetType type, const std::string& name)
+    {
+        AssetId id = Intern(type, name);
+        Asset& a = assets[id];
+        if (a.refs++ == 0)
+            Load(a);
+        return id;
+    }
+
+    // Gives a reference back, the last one unloads the asset
+    void Release(AssetId id)
+    {
+        if (id >= assets.size() || assets[id].refs == 0)
+            return;
+        Asset& a = assets[id];
+        if (--a.refs == 0)
+            Unload(a);
     }
 
+    const Texture2D& TextureAt(AssetId id) const
+    {
+        return assets[id].texture;
+    }
+
+    const Font& FontAt(AssetId id) const
+    {
+        return assets[id].font;
+    }
+
+    Shader& ShaderAt(AssetId id)
+    {
+        return assets[id].shader;
+    }
+
+    // Shorthands for assets kept for the whole run, the reference is never given back
     Texture2D GetTexture(std::string name)
     {
-        return LoadTexture((assetPath + "/textures/" + name + ".png").c_str());
+        return TextureAt(Acquire(AssetType::Texture, name));
     }
 
     Font GetFont(std::string name)
     {
-        return LoadFont((assetPath + "/fonts/" + name + ".ttf").c_str());
+        return FontAt(Acquire(AssetType::Font, name));
     }
 
     Shader GetShader(std::string vs, std::string fs)
     {
-        return LoadShader((vs.size() > 0 ? (assetPath + "/shaders/" + vs + ".vs").c_str() : ""),
-            fs.size() > 0 ? (assetPath + "/shaders/" + fs + ".fs").c_str() : "");
+        return ShaderAt(Acquire(AssetType::Shader, vs + "|" + fs));
     }
 
-    Model& GetModel(std::string name)
+    // Loads every model once, needs the window to be open. The first run bakes
+    // each into assets/models/cache, later ones map that instead of parsing.
+    void LoadModels()
     {
-        if (cachedModels[name].materialCount > 0)
-            return cachedModels[name];
+        for (int i = 0; i < (int)ModelId::Count; i++)
+        {
+            if (models[i].meshCount > 0)
+                continue;
+            models[i] = LoadModelCached(ModelFiles[i], modelMemory[i]);
+            /*for (int m = 0; m < models[i].materialCount; m++)
+                models[i].materials[m].shader = outlineShader;*/
+        }
+    }
 
-        Model m = cachedModels[name] = LoadModel((assetPath + "/models/" + name + ".obj").c_str());
-        /*for (int i = 0; i < m.materialCount; i++)
-            cachedModels[name].materials[i].shader = outlineShader;*/
-        return m;
+    // Draws index straight into the table, nothing is looked up by name once loaded
+    const Model& GetModel(ModelId id) const
+    {
+        return models[(int)id];
+    }
+
+    // Writes every loaded asset with its references and memory, then the totals
+    void ReportMemory(std::ostream& out) const
+    {
+        AssetMemory total;
+        auto line = [&](const char* type, const std::string& name, int refs, AssetMemory memory) {
+            out << type << " " << name << " refs " << refs << " cpu " << memory.cpu << " gpu " << memory.gpu << std::endl;
+            total.cpu += memory.cpu;
+            total.gpu += memory.gpu;
+        };
+        for (int i = 0; i < (int)ModelId::Count; i++)
+            if (models[i].meshCount > 0)
+                line("model", ModelFiles[i], 1, modelMemory[i]);
+        for (const Asset& a : assets)
+            if (a.refs > 0)
+                line(AssetTypeNames[(int)a.type], a.name, a.refs, a.memory);
+        out << "total cpu " << total.cpu << " gpu " << total.gpu << std::endl;
     }
 };
 #pragma endregion Resources Class
@@ -70,22 +423,6 @@ Resources resourceInstance;
 
 #pragma region Chess Piece Classes
 
-enum class PieceType {
-    Pawn = 0,
-    Rook = 1,
-    Knight = 2,
-    Bishop = 3,
-    Queen = 4,
-    King = 5
-};
-
-struct DataPiece {
-    int x, y;
-    PieceType type;
-    bool enPassant;
-    Color c;
-};
-
 class ChessHelper {
 public:
     // Helper function to convert a 2d array into 3d cords
@@ -117,200 +454,252 @@ public:
         return false;
     }
 
-    // Helper function to check if a piece is in a spot
-    static DataPiece IsPiece(float x, float y, std::list<DataPiece> pieces)
+    // Helper function to get the side a piece colour belongs to
+    static int ColorToSide(Color c)
     {
-        DataPiece pp;
-        pp.enPassant = false;
-        pp.type = PieceType::King;
-        pp.x = -1;
-        pp.y = -1;
-        for (DataPiece p : pieces)
-        {
-            int xx = std::roundf(x);
-            int yy = std::roundf(y);
+        return c.r == 255 ? White : Black;
+    }
+
+    // Helper function to convert a piece type to it's model.
+    static const Model& TypeToModel(PieceType t)
+    {
+        return resourceInstance.GetModel((ModelId)t);
+    }
+};
+
+// Draws the pieces grouped by type and colour. Each frame the pieces add
+// their transforms, then every group goes out as one instanced draw per mesh
+// rather than one DrawModelEx per piece. Without the instancing shader it
+// falls back to a DrawMesh per piece.
+class PieceRenderer {
+private:
+    Shader shader = {};
+    bool instanced = false;
+    std::vector<Matrix> transforms[PieceTypeCount][2]; // by type and side, cleared every Flush
 
-            if (std::roundf(p.x) == xx && std::roundf(p.y) == yy)
-                pp = p;
+public:
+    void Load(Resources& resources)
+    {
+        shader = resources.GetShader("instanced", "instanced");
+        int transformLoc = GetShaderLocationAttrib(shader, "instanceTransform");
+        instanced = transformLoc != -1;
+        if (instanced)
+        {
+            shader.locs[SHADER_LOC_MATRIX_MVP] = GetShaderLocation(shader, "mvp");
+            shader.locs[SHADER_LOC_MATRIX_MODEL] = transformLoc;
         }
-        return pp;
+        else
+            TraceLog(LOG_WARNING, "PIECES: no instancing shader, drawing one piece at a time");
     }
 
-    // Helper function to convert the board state into a smaller data state
-    static std::list<DataPiece> ConvertToDataState(std::list<Piece> pieces)
+    void Add(PieceType t, int side, Vector2 gridPos)
     {
-        
+        // The transform DrawModelEx would build: stood up, then moved onto its square
+        Vector3 pos = ChessHelper::GridPos(gridPos.x, gridPos.y);
+        transforms[(int)t][side].push_back(MatrixMultiply(MatrixRotate({ 1.0f, 0.0f, 0.0f }, -90.0f * DEG2RAD), MatrixTranslate(pos.x, pos.y, pos.z)));
     }
 
-    // Helper function to convert a piece type to it's model.
-    static Model TypeToModel(PieceType t)
+    void Flush()
     {
-        switch (t)
+        for (int t = 0; t < PieceTypeCount; t++)
         {
-        case PieceType::Pawn:
-            return resourceInstance.GetModel("pawn");
-            break;
-        case PieceType::Rook:
-            return resourceInstance.GetModel("rook");
-            break;
-        case PieceType::Bishop:
-            return resourceInstance.GetModel("bishop");
-            break;
-        case PieceType::Knight:
-            return resourceInstance.GetModel("knight");
-            break;
-        case PieceType::Queen:
-            return resourceInstance.GetModel("queen");
-            break;
-        case PieceType::King:
-            return resourceInstance.GetModel("king");
-            break;
+            for (int side = White; side <= Black; side++)
+            {
+                std::vector<Matrix>& group = transforms[t][side];
+                if (group.empty())
+                    continue;
+                const Model& model = ChessHelper::TypeToModel((PieceType)t);
+                for (Matrix& m : group)
+                    m = MatrixMultiply(model.transform, m);
+
+                Color tint = side == White ? WHITE : BLACK;
+                for (int i = 0; i < model.meshCount; i++)
+                {
+                    // Tinted the way DrawModelEx does it, then put back
+                    Material material = model.materials[model.meshMaterial[i]];
+                    Color& color = material.maps[MATERIAL_MAP_DIFFUSE].color;
+                    Color original = color;
+                    color = { (unsigned char)(original.r * tint.r / 255), (unsigned char)(original.g * tint.g / 255),
+                        (unsigned char)(original.b * tint.b / 255), (unsigned char)(original.a * tint.a / 255) };
+                    if (instanced)
+                    {
+                        material.shader = shader;
+                        DrawMeshInstanced(model.meshes[i], material, group.data(), (int)group.size());
+                    }
+                    else
+                    {
+                        for (Matrix& m : group)
+                            DrawMesh(model.meshes[i], material, m);
+                    }
+                    color = original;
+                }
+                group.clear();
+            }
         }
     }
 };
 
-class Piece {
-private:
-    float toX;
-    float toY;
+// Where a piece is drawn while it slides between squares. Only drawing reads
+// it, the game logic works on the piece's square.
+struct PieceAnimation {
+    Vector2 from = {};
+    Vector2 to = {};
+    Vector2 pos = {}; // grid position drawn this frame
+    float time = 1; // 0 to 1 through the slide, 1 when at rest
 
-    float lastX;
-    float lastY;
+    // Puts the piece straight on a square
+    void Place(int sq)
+    {
+        to = from = pos = { (float)SquareX(sq), (float)SquareY(sq) };
+        time = 1;
+    }
 
-    float lastMoveTime = 0;
-public:
-    bool isMoving = false;
+    void Start(int fromSq, int toSq)
+    {
+        from = { (float)SquareX(fromSq), (float)SquareY(fromSq) };
+        to = { (float)SquareX(toSq), (float)SquareY(toSq) };
+        pos = from;
+        time = 0;
+    }
 
-    bool enPassantable = false;
+    bool IsPlaying() const
+    {
+        return time < 1;
+    }
 
-    PieceType type;
-    float gX;
-    float gY;
+    void Update(float dt)
+    {
+        if (time < 1)
+        {
+            pos = { Lerp(from.x, to.x, time), Lerp(from.y, to.y, time) };
+            time += dt * 6;
+        }
+        else
+            pos = to;
+    }
+};
 
-    int moveLifeTime = 0;
+class Piece {
+public:
+    PieceType type;
+    int square; // 0-63, see SquareOf
 
-    bool hasMoved = false;
+    PieceAnimation animation;
 
     Color c;
 
-    Piece(float gridX, float gridY, PieceType _type, Color _c)
+    Piece(int sq, PieceType _type, Color _c)
     {
-        gX = gridX;
-        gY = gridY;
-
-        lastX = gX;
-        lastY = gY;
-        toX = gX;
-        toY = gY;
-
-        lastMoveTime = 1;
+        square = sq;
+        animation.Place(sq);
 
         type = _type;
         c = _c;
     }
 
-    // Function to obtain the moves of the current piece.
-    std::vector<Vector2> GetMoves(std::list<DataPiece> pieces)
+    // Function to obtain the moves of the current piece, from the same legal generator the AI uses.
+    void GetMoves(const GameState& game, MoveList& moves)
     {
-        std::vector<Vector2> moves;
-        std::vector<bool> blocked;
-        switch (type)
-        {
-        case PieceType::Pawn:
-            
-            break;
-        case PieceType::Knight:
-
-            break;
-        case PieceType::Bishop:
-            
-            break;
-        case PieceType::Queen:
-            
-        case PieceType::King:
-            // I don't wanna talk about this code... lol
-            
-        case PieceType::Rook:
-
-            break;
-        }
-
-        // Clean moves to check for off board stuff
-
-        std::vector<Vector2> copied = moves;
+        GeneratePieceMoves(game, square, moves);
+        // The board always promotes to a queen, so the other choices aren't shown
+        int kept = 0;
+        for (int i = 0; i < moves.Size(); i++)
+            if (moves[i].flag != MoveFlag::Promotion || moves[i].promotion == PieceType::Queen)
+                moves[kept++] = moves[i];
+        moves.Resize(kept);
+    }
 
-        int i = 0;
-        for (Vector2 move : copied)
-        {
-            bool remove = false;
+    void Move(int to)
+    {
+        animation.Start(square, to);
+        square = to;
+    }
 
-            if (move.x < 1)
-                remove = true;
-            if (move.x > 8)
-                remove = true;
+    // Queues the piece for the renderer, which draws it with the others of its kind
+    void Draw(PieceRenderer& renderer)
+    {
+        animation.Update(GetFrameTime());
+        renderer.Add(type, ChessHelper::ColorToSide(c), animation.pos);
+    }
+};
 
-            if (move.y < 1)
-                remove = true;
-            if (move.y > 8)
-                remove = true;
+// The pieces on screen plus a mailbox from every square to the index of the
+// piece standing there, so finding what's on a square never scans the list.
+// Everything that moves, takes or adds a piece goes through here to keep the
+// two in step. The match's position is the real one, this only follows it.
+class PieceSet {
+public:
+    std::vector<Piece> pieces;
+    int mailbox[64];
 
-            if (remove)
-            {
-                moves.erase(moves.begin() + i);
-                // shift back array
-                i--;
-            }
+    PieceSet()
+    {
+        pieces.reserve(64); // a board holds no more, so adding a piece never moves the others
+        Clear();
+    }
 
-            i++;
-        }
+    void Clear()
+    {
+        pieces.clear();
+        for (int& id : mailbox)
+            id = -1;
+    }
 
-        return moves;
+    void Add(const Piece& p)
+    {
+        mailbox[p.square] = (int)pieces.size();
+        pieces.push_back(p);
     }
 
-    void Move(int x, int y)
+    // Index of the piece on a square, -1 when it's empty
+    int At(int sq) const
     {
-        // We take ints for easy stuff but they're actually floats
-        moveLifeTime++;
-        lastX = std::roundf(gX);
-        lastY = std::roundf(gY);
-        int diff = std::abs(lastY - y);
-        if (diff == 2)
-            enPassantable = true;
-        else
-            enPassantable = false;
-        toX = x;
-        toY = y;
-        hasMoved = true;
+        return mailbox[sq];
+    }
 
-        lastMoveTime = 0;
+    void Move(int id, int to)
+    {
+        mailbox[pieces[id].square] = -1;
+        pieces[id].Move(to);
+        mailbox[to] = id;
     }
 
-    void Draw()
+    // Takes the piece on a square off the screen. The last piece moves into
+    // its slot, the order pieces are drawn in doesn't matter.
+    void Capture(int sq)
     {
-        isMoving = lastMoveTime < 1;
-        if (lastMoveTime < 1)
+        int id = mailbox[sq];
+        if (id == -1)
+            return;
+        mailbox[sq] = -1;
+        if (id != (int)pieces.size() - 1)
         {
-            gX = Lerp(lastX, toX, lastMoveTime / 1);
-            gY = Lerp(lastY, toY, lastMoveTime / 1);
-            lastMoveTime += GetFrameTime() * 6;
+            pieces[id] = pieces.back();
+            mailbox[pieces[id].square] = id;
         }
-        else
-        {
-            gX = toX;
-            gY = toY;
-        }
-
-        DrawModelEx(ChessHelper::TypeToModel(type), ChessHelper::GridPos(gX, gY), {1.0f, 0.0f, 0.0f}, -90.0f, {1,1,1}, c);
+        pieces.pop_back();
     }
 };
 
-std::map<int, std::map<int, bool>> convertBoardIntoBools(std::vector<Piece> pieces)
+// Moves the pieces on screen to follow a move, before the match plays it
+void ApplyMove(PieceSet& set, const GameState& game, const Move& m)
 {
-    std::map<int, std::map<int, bool>> board;
-    for (Piece p : pieces)
-        board[p.gX][p.gY] = true;
+    if (m.IsNull() || set.At(m.from) == -1)
+        return;
+    int side = game.board.SideAt(m.from);
 
-    return board;
+    set.Capture(m.flag == MoveFlag::EnPassant ? m.to + (side == White ? -8 : 8) : m.to);
+    set.Move(set.At(m.from), m.to);
+    if (m.flag == MoveFlag::Castle)
+    {
+        int y = SquareY(m.to);
+        int rookFrom = m.to > m.from ? SquareOf(8, y) : SquareOf(1, y);
+        int rookTo = m.to > m.from ? SquareOf(6, y) : SquareOf(4, y);
+        if (set.At(rookFrom) != -1)
+            set.Move(set.At(rookFrom), rookTo);
+    }
+    else if (m.flag == MoveFlag::Promotion)
+        set.pieces[set.At(m.to)].type = m.promotion;
 }
 
 #pragma endregion Chess Piece Classes
@@ -319,6 +708,7 @@ std::map<int, std::map<int, bool>> convertBoardIntoBools(std::vector<Piece> piec
 
 struct UIItem {
     Texture2D texture;
+    AssetId textureId = NoAsset; // the reference the item holds on its texture
     std::string detail;
 
     std::function<void(std::type_identity_t<UIItem*>)> callback;
@@ -338,7 +728,10 @@ public:
 
     Vector2 anchorPos;
 
-    ChessUI(Resources& resourceInstance)
+    Resources& resources; // where the item textures come from and go back to
+    std::unordered_map<std::string, AssetId> icons; // a reference on every icon shown so far, so clearing the bar never unloads one
+
+    ChessUI(Resources& resourceInstance) : resources(resourceInstance)
     {
         actionBar = resourceInstance.GetTexture("Action_Bar_UI");
         actionBarItemBorder = resourceInstance.GetTexture("Action_Item_Border_UI");
@@ -383,7 +776,11 @@ public:
         UIItem nI;
         nI.callback = callback;
         nI.detail = detail;
-        nI.texture = resourceInstance.GetTexture(image);
+        // The bar is rebuilt on every click, keeping the icon loaded saves decoding it again each time
+        if (!icons.count(image))
+            icons[image] = resourceInstance.Acquire(AssetType::Texture, image);
+        nI.textureId = resourceInstance.Acquire(AssetType::Texture, image);
+        nI.texture = resourceInstance.TextureAt(nI.textureId);
 
         // Calculate some arbitary stuff because columns and rows and I love ui design
         float max = (actionBar.width - actionBarItemBorder.width) / (actionBarItemBorder.width);
@@ -403,12 +800,21 @@ public:
         items.push_back(nI);
     }
 
+    // Removes every item and gives back their textures
+    void Clear()
+    {
+        for (UIItem& item : items)
+            resources.Release(item.textureId);
+        items.clear();
+    }
+
     void DeleteItem(std::string detail)
     {
         for (int i = 0; i < items.size(); i++)
         {
             if (detail == items[i].detail) // If it's detail is the specified one
             {
+                resources.Release(items[i].textureId);
                 items.erase(items.begin() + i); // Erase it
                 break; // Break so we stop looping because we shift the index stuff. it'll cause a out of bounds null ref if we dont.
             }
@@ -465,21 +871,28 @@ int main()
 
     SetTargetFPS(120);
 
+    // Build the sliding piece attack tables before any moves get generated
+
+    Attacks::Init();
+
     // Create a new instance of our resource class with the "assets" folder.
 
     resourceInstance = Resources("assets");
 
+    resourceInstance.LoadModels();
+
     //Shader outline = resourceInstance.GetShader("", "outline");
 
     //resourceInstance.setModelOutlineShader(outline);
 
-    Model board = resourceInstance.GetModel("board");
+    const Model& board = resourceInstance.GetModel(ModelId::Board);
 
-    Model select = resourceInstance.GetModel("selected");
+    const Model& select = resourceInstance.GetModel(ModelId::Selected);
 
     Font menuFont = resourceInstance.GetFont("Arial Bold");
     Texture2D menuBG = resourceInstance.GetTexture("menuBG");
     Texture2D aiCheckbox = resourceInstance.GetTexture("AI_Checkbox");
+    Texture2D mineralsIcon = resourceInstance.GetTexture("Minerals_UI");
 
     raylib::Camera3D c = raylib::Camera3D({ 25,60,-30}, {-40,-18,-30}, {0,1,0}, 75, CAMERA_PERSPECTIVE);
 
@@ -487,9 +900,55 @@ int main()
 
     float turnLerp = 0;
 
-    std::vector<Piece> pieces = {};
+    PieceSet pieces; // what's drawn, indexed by square
+
+    PieceRenderer pieceRenderer;
+    pieceRenderer.Load(resourceInstance);
+
+    Match match; // Rules, turns and economy, the pieces on screen follow it
+
+    GameState& game = match.state;
+
+    // AI opponent
+
+    const int AiHashSizeMB = 64;
+    const int AiThinkTimeMs = 500; // about as long as the end turn animation at normal speed
+    // Leaves a core for rendering, SelfPlay --search-threads shows how the search scales on a machine
+    const int AiThreads = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+
+    // Declared before the worker so they outlive it, its thread can still be reading them while it shuts down
+    Nnue::Network aiNetwork;
+    OpeningBook aiBook;
+    Endgame::Tables aiTables;
+
+    TranspositionTable aiTable = TranspositionTable(AiHashSizeMB);
+    SearchWorker aiWorker = SearchWorker(aiTable, AiThreads); // thinks on its own threads
 
-    std::vector<Vector2> highlights = {};
+    // The AI uses the trained network when one ships with the assets, the hand-written evaluation otherwise
+    if (aiNetwork.Load("assets/nets/default.nnue"))
+        aiWorker.SetNetwork(&aiNetwork);
+    else
+        TraceLog(LOG_INFO, "AI: %s, using the built-in evaluation", aiNetwork.error.c_str());
+
+    // Openings the book knows are played without thinking, it's mapped rather than read so this costs nothing
+    if (aiBook.Open("assets/opening.book"))
+        aiWorker.SetBook(&aiBook);
+    else
+        TraceLog(LOG_INFO, "AI: %s, searching every move", aiBook.error.c_str());
+
+    // Endings with few pieces are looked up rather than searched when TableGen's files are there
+    if (aiTables.Open("assets/tables") > 0)
+        aiWorker.SetTables(&aiTables);
+    for (const std::string& error : aiTables.errors)
+        TraceLog(LOG_WARNING, "AI: %s", error.c_str());
+
+    GameResult result = GameResult::Ongoing; // once the game is decided the board takes no more input
+
+    int aiRequest = 0; // id of the search for the current AI turn, 0 when none is running
+    bool aiNewGame = false;
+    SearchProgress aiProgress;
+
+    MoveList highlights; // moves of the selected piece
 
     // Gameplay Variables
 
@@ -523,14 +982,58 @@ int main()
 
     ChessUI cUi = ChessUI(resourceInstance);
 
+    // With no piece selected the action bar trains units: one item for each
+    // kind, then the side's queue, where clicking an order cancels it
+    bool rebuildBar = false; // item callbacks set this, the bar can't change while it's being clicked
+    auto showTraining = [&]() {
+        cUi.Clear();
+        if (result != GameResult::Ongoing || (ai && turn))
+            return;
+        int side = game.sideToMove;
+        auto icon = [side](PieceType t) { return std::string(UnitIconNames[(int)t]) + (side == Black ? "_Black_Icon" : "_Icon"); };
+        for (PieceType t : { PieceType::Pawn, PieceType::Knight, PieceType::Bishop, PieceType::Rook, PieceType::Queen })
+            cUi.CreateItem(std::string("train ") + UnitIconNames[(int)t], icon(t), [&, t](UIItem*) {
+                if (match.Train(t))
+                    rebuildBar = true;
+            }, resourceInstance);
+        for (int slot = 0; slot < game.trainingCount[side]; slot++)
+        {
+            cUi.CreateItem("queue " + std::to_string(slot), icon(game.training[side][slot].type), [&, slot](UIItem*) {
+                if (match.CancelTraining(slot))
+                    rebuildBar = true;
+            }, resourceInstance);
+            cUi.items.back().isSelected = true;
+        }
+    };
+
+    // Moves a piece on screen and in the match, the turn goes on
+    auto playMove = [&](const Move& m) {
+        ApplyMove(pieces, game, m);
+        match.PlayMove(m);
+        result = match.Result();
+    };
+
+    auto endTurn = [&]() {
+        match.EndTurn();
+        turn = !turn;
+        turnLerp = 0;
+        selected = NULL;
+        highlights.Clear();
+        for (const MatchEvent& e : match.events)
+            if (e.type == MatchEventType::UnitTrained)
+                pieces.Add(Piece(e.square, e.piece, e.side == White ? WHITE : BLACK));
+        aiRequest = 0;
+        aiProgress = SearchProgress();
+        result = match.Result();
+        showTraining();
+    };
+
     while (!shouldClose)
     {
         UpdateCamera(&c);
         if (!menu)
         {
 #pragma region Game
-            bool currentTurn = !turn; // white or blacks turn
-
 #pragma region End Turn Animation
             if (turn && c.position.x > -100)
             {
@@ -582,14 +1085,65 @@ int main()
 
             if (mReleased)
                 cUi.Click(mousePos);
+            if (rebuildBar)
+            {
+                rebuildBar = false;
+                showTraining();
+            }
+
+            bool gameOver = result != GameResult::Ongoing;
 
-            if (IsKeyPressed(KEY_SPACE))
+            if (IsKeyPressed(KEY_SPACE) && !gameOver)
             {
                 std::cout << "end turn" << std::endl;
-                turn = !turn;
-                turnLerp = 0;
-                for (Piece& p : pieces)
-                    p.hasMoved = false;
+                endTurn();
+            }
+
+            // What every loaded asset costs, for keeping an eye on memory
+            if (IsKeyPressed(KEY_F3))
+                resourceInstance.ReportMemory(std::cout);
+
+            if (IsKeyPressed(KEY_ESCAPE))
+            {
+                // Back to the menu, whatever the AI was thinking about is thrown away
+                aiWorker.Cancel();
+                aiRequest = 0;
+                menu = true;
+                selected = NULL;
+                highlights.Clear();
+                cUi.Clear();
+            }
+
+            // The AI plays black, it starts thinking while the camera turns round
+            if (ai && turn && aiRequest == 0 && !gameOver)
+            {
+                // It trains first so the search sees the queue it's playing with
+                match.TrainStrongest();
+                SearchRequest request;
+                request.state = game;
+                request.limits.timeMs = AiThinkTimeMs;
+                request.history = match.history;
+                request.newGame = aiNewGame;
+                aiRequest = aiWorker.Submit(request);
+                if (aiRequest != 0)
+                    aiNewGame = false;
+            }
+
+            SearchProgress update;
+            while (aiWorker.Poll(update))
+                if (update.id == aiRequest)
+                    aiProgress = update;
+
+            // The move is played once the search is done and the camera has arrived
+            if (ai && turn && aiRequest != 0 && aiProgress.finished && turnLerp >= 1 && !gameOver)
+            {
+                SearchResult& result = aiProgress.result;
+                std::cout << "ai " << result.best.ToString() << (result.fromBook ? " book" : "") << " depth " << result.depth << " score " << result.score << " nodes " << result.nodes
+                    << " nps " << result.nps << " threads " << result.threads << " hashfull " << result.hashFull << std::endl;
+                // The search plays one move a turn, a subset of what the rules allow
+                if (!result.best.IsNull())
+                    playMove(result.best);
+                endTurn();
             }
 
 #pragma endregion Gameplay
@@ -608,6 +1162,14 @@ int main()
 
             DrawModelEx(board, { 0,0,0 }, { 1.0f, 0.0f, 0.0f }, 90.0f, { 1,1,1 }, WHITE);
 
+            // Mineral nodes that haven't been mined out
+            for (int n = 0; n < game.mining.count; n++)
+            {
+                int sq = game.mining.square[n];
+                if (game.board.minerals & SquareBit(sq))
+                    DrawModelEx(resourceInstance.GetModel(n % 2 ? ModelId::Mineral2 : ModelId::Mineral1), ChessHelper::GridPos(SquareX(sq), SquareY(sq)), { 1.0f, 0.0f, 0.0f }, -90.0f, { 1,1,1 }, WHITE);
+            }
+
             // Selection box
 
             for (int x = 1; x < 9; x++)
@@ -627,7 +1189,7 @@ int main()
 
             if (selected)
             {
-                Vector3 pos = ChessHelper::GridPos(selected->gX, selected->gY);
+                Vector3 pos = ChessHelper::GridPos(selected->animation.pos.x, selected->animation.pos.y);
                 // center
                 pos.x += 8;
                 pos.y += 0.1;
@@ -643,9 +1205,9 @@ int main()
             bool selectedPiece = false;
 
 
-            for (Piece& p : pieces)
+            for (Piece& p : pieces.pieces)
             {
-                p.Draw();
+                p.Draw(pieceRenderer);
 
                 // Check if you own the piece
                 // Kinda jank
@@ -655,9 +1217,9 @@ int main()
                         continue;
                 // Check if you clicked on em
 
-                bool canMove = ((p.c.r == 255 && !turn) || (p.c.r == 0 && turn)) && !p.hasMoved;
+                bool canMove = ((p.c.r == 255 && !turn) || (p.c.r == 0 && turn)) && !match.HasMoved(p.square) && !gameOver;
 
-                if (ChessHelper::Tile_IsHovered(p.gX, p.gY, c, turn) && selected == NULL && canMove)
+                if (ChessHelper::Tile_IsHovered(SquareX(p.square), SquareY(p.square), c, turn) && selected == NULL && canMove)
                 {
                     if (mReleased)
                     {
@@ -665,7 +1227,8 @@ int main()
                         // would be o^2 if this wasn't just one piece. Luckily it is only one piece
                         
                         selected = &p;
-                        cUi.items.clear();
+                        p.GetMoves(game, highlights);
+                        cUi.Clear();
                         cUi.CreateItem("move", "Move_Icon", [&](UIItem* item) {
                             item->isSelected = true;
                             isMoving = true;
@@ -676,61 +1239,43 @@ int main()
                 }
             }
 
+            pieceRenderer.Flush();
+
    
-                for (Vector2& highlight : highlights)
+                for (Move& highlight : highlights)
                 {
-                    Vector3 pos = ChessHelper::GridPos(highlight.x, highlight.y);
+                    int hX = SquareX(highlight.to);
+                    int hY = SquareY(highlight.to);
+                    Vector3 pos = ChessHelper::GridPos(hX, hY);
                     // center
                     pos.x += 8;
                     pos.z -= 8;
                     pos.y += 0.1;
                     Color cc = WHITE;
                     cc.a = 125;
-                    bool stop = false;
 
-                    int pId = 0;
-                    int takeId = -1;
-                    for (Piece& p : pieces)
-                    {
-                        if (p.gX == highlight.x && p.gY == highlight.y)
-                        {
-                            if (currentTurn && p.c.r == 255)
-                            {
-                                stop = true;
-                                break;
-                            }
-                            else if (!currentTurn && p.c.r == 0)
-                            {
-                                stop = true;
-                                break;
-                            }
-                            else
-                                takeId = pId;
-                        }
-                        pId++;
-                    }
+                    // Highlights only ever come from legal moves, so anything on the square is an enemy
+                    bool take = highlight.flag == MoveFlag::EnPassant || pieces.At(highlight.to) != -1;
 
-                    if (takeId != -1)
+                    if (take)
                     {
                         cc = RED;
                         cc.a = 125;
                     }
                     DrawModelEx(select, pos, { 1.0f,0.0f,0.0f }, -90, { 1,1,1 }, cc);
-                    if (stop)
-                        continue;
 
 
                     // detect if you click here
 
-                    if (ChessHelper::Tile_IsHovered(highlight.x, highlight.y, c, turn))
+                    if (ChessHelper::Tile_IsHovered(hX, hY, c, turn))
                     {
                         if (mDown && selected && isMoving)
                         {
-                            selected->Move(highlight.x, highlight.y);
-                            if (takeId != -1)
-                                pieces.erase(pieces.begin() + takeId);
+                            // Takes care of captures, en passant, castling and promotion
+                            playMove(highlight);
                             isMoving = false;
                             selected = NULL;
+                            rebuildBar = true;
                         }
                     }
                 }
@@ -739,9 +1284,9 @@ int main()
 
             if (mDown && !selectedPiece && !cUi.isHovered)
             {
-                cUi.items.clear();
+                showTraining();
                 selected = NULL;
-                highlights.clear();
+                highlights.Clear();
             }
 
             EndMode3D();
@@ -753,6 +1298,40 @@ int main()
 
             cUi.Draw(mousePos);
 
+            // Each side's bank and what its next turn brings in, mining included
+            for (int side = White; side <= Black; side++)
+            {
+                Vector2 pos = { (float)GetScreenWidth() - 230, 10.0f + side * 40 };
+                DrawTextureEx(mineralsIcon, pos, 0, 0.5f, WHITE);
+                std::string bank = std::string(side == White ? "White " : "Black ") + std::to_string(game.minerals[side])
+                    + " (+" + std::to_string(TurnIncome + game.mining.income[side]) + ")";
+                if (game.trainingCount[side])
+                    bank += "  " + std::string(UnitIconNames[(int)game.training[side][0].type]) + " in " + std::to_string(match.TrainingTurnsLeft(side, 0));
+                DrawTextEx(menuFont, bank.c_str(), { pos.x + 42, pos.y + 8 }, 20, 1, WHITE);
+            }
+
+            if (gameOver)
+            {
+                const char* text = result == GameResult::WhiteWins ? "White wins" : result == GameResult::BlackWins ? "Black wins" : "Draw";
+                Vector2 size = MeasureTextEx(menuFont, text, 64, 1);
+                DrawTextEx(menuFont, text, { (GetScreenWidth() - size.x) / 2, 60 }, 64, 1, WHITE);
+                Vector2 hintSize = MeasureTextEx(menuFont, "Escape for the menu", 20, 1);
+                DrawTextEx(menuFont, "Escape for the menu", { (GetScreenWidth() - hintSize.x) / 2, 130 }, 20, 1, WHITE);
+            }
+            else if (ai && turn)
+            {
+                std::string thinking = "Thinking...";
+                if (aiProgress.result.depth > 0)
+                {
+                    thinking += "  depth " + std::to_string(aiProgress.result.depth) + "  nodes " + std::to_string(aiProgress.result.nodes)
+                        + "  nps " + std::to_string(aiProgress.result.nps) + "  threads " + std::to_string(aiProgress.result.threads)
+                        + "  hash " + std::to_string(aiProgress.result.hashFull / 10) + "%  pv";
+                    for (Move& m : aiProgress.result.pv)
+                        thinking += " " + m.ToString();
+                }
+                DrawTextEx(menuFont, thinking.c_str(), { 10, 24 }, 20, 1, WHITE);
+            }
+
             EndDrawing();
 #pragma endregion 2D
 #pragma endregion Draw
@@ -842,22 +1421,24 @@ int main()
                 startLerpY = c.position.y;
                 startLerpZ = c.position.z;
 
-                cUi.items.clear();
-
-                // Start Pieces
-                pieces.clear();
-                /*pieces.push_back(Piece(4, 1, PieceType::King, WHITE));
-                pieces.push_back(Piece(4, 2, PieceType::Pawn, WHITE));
-                pieces.push_back(Piece(5, 2, PieceType::Pawn, WHITE));
-                pieces.push_back(Piece(4, 8, PieceType::King, BLACK));
-                pieces.push_back(Piece(4, 7, PieceType::Pawn, BLACK));
-                pieces.push_back(Piece(5, 7, PieceType::Pawn, BLACK));*/
-                // normal chess
-                for (int i = 1; i < 9; i++)
+                cUi.Clear();
+
+                // Start Pieces, the match sets up the board and the pieces are made from it
+                match.Reset();
+                result = GameResult::Ongoing;
+                showTraining();
+                pieces.Clear();
+                Bitboard occupied = game.board.Occupied();
+                while (occupied)
                 {
-                    pieces.push_back(Piece(i, 2, PieceType::Pawn, WHITE));
-                    pieces.push_back(Piece(i, 7, PieceType::Pawn, BLACK));
+                    int sq = PopLowest(occupied);
+                    pieces.Add(Piece(sq, game.board.TypeAt(sq), game.board.IsSide(sq, White) ? WHITE : BLACK));
                 }
+
+                aiWorker.Cancel();
+                aiRequest = 0;
+                aiProgress = SearchProgress();
+                aiNewGame = true;
             }
             break;
         case 1:
@@ -874,6 +1455,8 @@ int main()
         }
     }
 
+    // The GL context goes with the window, the GPU side has to be freed first
+    resourceInstance.UnloadAll();
     CloseWindow();
 
 
@@ -0,0 +1,197 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timer wheel: schedules payloads some number of ticks ahead and
+// hands back everything due on a tick in one batch. Scheduling and cancelling
+// are O(1), and a tick only looks at the one slot that's due, so it costs the
+// same however many timers are waiting. What a tick is is up to the owner,
+// Match ticks once per turn.
+//
+// Timers less than 64 ticks out sit in the first wheel's slot for their tick,
+// later ones in a coarser wheel and move down a level each time the finer
+// wheel comes round to them.
+typedef uint64_t TimerId; // 0 is never a live timer
+
+template <typename T>
+class TimerWheel {
+private:
+    static const int SlotBits = 6;
+    static const int Slots = 1 << SlotBits;
+    static const int Levels = 4;
+    static const uint32_t None = UINT32_MAX;
+    static const int16_t Free = -1;
+    static const int16_t Due = -2; // taken out of its slot, being handed back
+
+    struct Timer {
+        T payload;
+        uint64_t expires = 0;
+        uint32_t prev = None;
+        uint32_t next = None;
+        uint32_t generation = 1;
+        int16_t slot = Free;
+    };
+
+    std::vector<Timer> timers; // indices stay valid, finished ones are reused
+    uint32_t freeList = None;
+    uint32_t heads[Levels * Slots];
+    std::vector<uint32_t> due;
+    uint64_t now = 0;
+    size_t pending = 0;
+
+    static TimerId MakeId(uint32_t index, uint32_t generation)
+    {
+        return ((uint64_t)generation << 32) | index;
+    }
+
+    void Link(uint32_t i)
+    {
+        Timer& t = timers[i];
+        uint64_t delta = t.expires - now;
+        int level = 0;
+        while (level < Levels - 1 && delta >= (uint64_t)1 << (SlotBits * (level + 1)))
+            level++;
+        // Past the last wheel it waits in the slot that comes round last and is placed again from there
+        int slot = delta >= (uint64_t)1 << (SlotBits * Levels)
+            ? (int)(((now >> (SlotBits * level)) + Slots - 1) & (Slots - 1))
+            : (int)((t.expires >> (SlotBits * level)) & (Slots - 1));
+        t.slot = (int16_t)(level * Slots + slot);
+        t.prev = None;
+        t.next = heads[t.slot];
+        if (t.next != None)
+            timers[t.next].prev = i;
+        heads[t.slot] = i;
+    }
+
+    void Unlink(uint32_t i)
+    {
+        Timer& t = timers[i];
+        if (t.prev != None)
+            timers[t.prev].next = t.next;
+        else
+            heads[t.slot] = t.next;
+        if (t.next != None)
+            timers[t.next].prev = t.prev;
+    }
+
+    void Release(uint32_t i)
+    {
+        Timer& t = timers[i];
+        t.slot = Free;
+        t.generation++;
+        t.next = freeList;
+        freeList = i;
+        pending--;
+    }
+
+    // Moves a coarse slot's timers down now that the wheel below has come round to it
+    void Cascade(int level)
+    {
+        int slot = level * Slots + (int)((now >> (SlotBits * level)) & (Slots - 1));
+        uint32_t i = heads[slot];
+        heads[slot] = None;
+        while (i != None)
+        {
+            uint32_t next = timers[i].next;
+            Link(i);
+            i = next;
+        }
+    }
+
+public:
+    TimerWheel()
+    {
+        Clear();
+    }
+
+    // Drops every timer and starts the clock again from tick 0
+    void Clear()
+    {
+        timers.clear();
+        freeList = None;
+        for (uint32_t& head : heads)
+            head = None;
+        now = 0;
+        pending = 0;
+    }
+
+    uint64_t Now() const
+    {
+        return now;
+    }
+
+    size_t Pending() const
+    {
+        return pending;
+    }
+
+    // Fires payload on the tick delay ticks from now, at least the next one
+    TimerId Schedule(uint64_t delay, const T& payload)
+    {
+        uint32_t i = freeList;
+        if (i != None)
+            freeList = timers[i].next;
+        else
+        {
+            i = (uint32_t)timers.size();
+            timers.emplace_back();
+        }
+        Timer& t = timers[i];
+        t.payload = payload;
+        t.expires = now + (delay > 0 ? delay : 1);
+        pending++;
+        Link(i);
+        return MakeId(i, t.generation);
+    }
+
+    // False when the timer already fired or was cancelled
+    bool Cancel(TimerId id)
+    {
+        uint32_t i = (uint32_t)id;
+        if (i >= timers.size() || timers[i].generation != (uint32_t)(id >> 32) || timers[i].slot < 0)
+            return false;
+        Unlink(i);
+        Release(i);
+        return true;
+    }
+
+    // Ticks when a timer fires, or 0 when it isn't pending
+    uint64_t Remaining(TimerId id) const
+    {
+        uint32_t i = (uint32_t)id;
+        if (i >= timers.size() || timers[i].generation != (uint32_t)(id >> 32) || timers[i].slot < 0)
+            return 0;
+        return timers[i].expires - now;
+    }
+
+    // Moves the clock on one tick and calls fire(payload) for every timer due
+    // on it. fire can schedule and cancel, new timers go on later ticks.
+    template <typename F>
+    void Advance(F&& fire)
+    {
+        now++;
+        // Coarsest first, so what comes down from it is moved on again by the level below
+        int top = 0;
+        while (top + 1 < Levels && (now & (((uint64_t)1 << (SlotBits * (top + 1))) - 1)) == 0)
+            top++;
+        for (int level = top; level >= 1; level--)
+            Cascade(level);
+
+        // The whole slot is taken out first so fire can't disturb the batch
+        int slot = (int)(now & (Slots - 1));
+        due.clear();
+        for (uint32_t i = heads[slot]; i != None; i = timers[i].next)
+        {
+            timers[i].slot = Due;
+            due.push_back(i);
+        }
+        heads[slot] = None;
+        for (uint32_t i : due)
+        {
+            T payload = timers[i].payload;
+            Release(i);
+            fire(payload);
+        }
+    }
+};
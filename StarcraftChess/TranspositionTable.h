@@ -0,0 +1,239 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+enum class Bound : uint8_t {
+    None = 0,
+    Upper = 1, // score failed low, the real value is at most this
+    Lower = 2, // score failed high, the real value is at least this
+    Exact = 3
+};
+
+struct TTEntry {
+    uint32_t move = 0;
+    int16_t score = 0;
+    int8_t depth = 0;
+    Bound bound = Bound::None;
+};
+
+// Scores within this distance of the mate value are mate scores, and endgame
+// table results sit the same distance below TableWinScore. Both count plies
+// from the root, so they're stored relative to the node instead and stay
+// valid when the same position is reached at a different ply.
+const int MateScore = 30000;
+const int TableWinScore = 20000; // endgame table wins, below any mate the search finds itself
+const int MaxMatePly = 256;
+const int DecisiveScore = TableWinScore - MaxMatePly; // mates and table results, the rest is evaluation
+
+inline int ScoreToTT(int score, int ply)
+{
+    if (score >= DecisiveScore)
+        return score + ply;
+    if (score <= -DecisiveScore)
+        return score - ply;
+    return score;
+}
+
+inline int ScoreFromTT(int score, int ply)
+{
+    if (score >= DecisiveScore)
+        return score - ply;
+    if (score <= -DecisiveScore)
+        return score + ply;
+    return score;
+}
+
+// Shared hash table of searched positions. Each bucket fills one cache line
+// and holds two depth-preferred slots and two always-replace slots.
+//
+// Search threads read and write it without locks: a slot stores its data word
+// and the key XORed with that data. If two threads write the same slot at once
+// and the words come from different writes, the XOR no longer gives back the
+// key and the probe simply misses instead of returning a corrupt entry.
+class TranspositionTable {
+private:
+    struct Slot {
+        std::atomic<uint64_t> check; // key ^ data
+        std::atomic<uint64_t> data;
+    };
+
+    struct alignas(64) Bucket {
+        Slot slots[4]; // 0 and 1 are depth-preferred, 2 and 3 always replace
+    };
+
+    static_assert(sizeof(Bucket) == 64, "bucket must fill one cache line");
+
+    std::unique_ptr<Bucket[]> buckets;
+    uint64_t mask = 0;
+    uint8_t generation = 0;
+
+    // data layout: move 32 | score 16 | depth 8 | bound 2 | generation 6
+    static uint64_t Pack(uint32_t move, int score, int depth, Bound bound, uint8_t gen)
+    {
+        return (uint64_t)move
+            | (uint64_t)(uint16_t)(int16_t)score << 32
+            | (uint64_t)(uint8_t)(int8_t)depth << 48
+            | (uint64_t)((uint8_t)bound | (gen << 2)) << 56;
+    }
+
+    static TTEntry Unpack(uint64_t data)
+    {
+        TTEntry e;
+        e.move = (uint32_t)data;
+        e.score = (int16_t)(uint16_t)(data >> 32);
+        e.depth = (int8_t)(uint8_t)(data >> 48);
+        e.bound = (Bound)((data >> 56) & 3);
+        return e;
+    }
+
+    static uint8_t Generation(uint64_t data)
+    {
+        return (uint8_t)(data >> 58);
+    }
+
+    static int Depth(uint64_t data)
+    {
+        return (int8_t)(uint8_t)(data >> 48);
+    }
+
+    Bucket& BucketFor(uint64_t key) const
+    {
+        return buckets[key & mask];
+    }
+
+public:
+    TranspositionTable(size_t megabytes = 16)
+    {
+        Resize(megabytes);
+    }
+
+    // Rounds down to a power of two number of buckets, at least one
+    void Resize(size_t megabytes)
+    {
+        size_t count = 1;
+        size_t target = megabytes * 1024 * 1024 / sizeof(Bucket);
+        while (count * 2 <= target)
+            count *= 2;
+        buckets.reset(new Bucket[count]);
+        mask = count - 1;
+        Clear();
+    }
+
+    size_t SizeInBytes() const
+    {
+        return (mask + 1) * sizeof(Bucket);
+    }
+
+    void Clear()
+    {
+        for (uint64_t i = 0; i <= mask; i++)
+            for (Slot& s : buckets[i].slots)
+            {
+                s.check.store(0, std::memory_order_relaxed);
+                s.data.store(0, std::memory_order_relaxed);
+            }
+        generation = 0;
+    }
+
+    // Called once per search so entries from older searches get replaced first
+    void NewSearch()
+    {
+        generation = (generation + 1) & 63;
+    }
+
+    void Prefetch(uint64_t key) const
+    {
+#if defined(_MSC_VER)
+        _mm_prefetch((const char*)&BucketFor(key), 3);
+#else
+        __builtin_prefetch(&BucketFor(key));
+#endif
+    }
+
+    bool Probe(uint64_t key, TTEntry& out) const
+    {
+        Bucket& b = BucketFor(key);
+        for (Slot& s : b.slots)
+        {
+            uint64_t data = s.data.load(std::memory_order_relaxed);
+            uint64_t check = s.check.load(std::memory_order_relaxed);
+            if ((check ^ data) == key && data != 0)
+            {
+                out = Unpack(data);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Store(uint64_t key, uint32_t move, int score, int depth, Bound bound)
+    {
+        Bucket& b = BucketFor(key);
+        uint64_t data = Pack(move, score, depth, bound, generation);
+
+        int target = -1;
+        for (int i = 0; i < 4; i++)
+        {
+            uint64_t old = b.slots[i].data.load(std::memory_order_relaxed);
+            if ((b.slots[i].check.load(std::memory_order_relaxed) ^ old) == key && old != 0)
+            {
+                // Same position, keep the old best move if this search didn't find one
+                if (move == 0)
+                    data = Pack(Unpack(old).move, score, depth, bound, generation);
+                if (i < 2 && depth < Depth(old) && bound != Bound::Exact && Generation(old) == generation)
+                    return;
+                target = i;
+                break;
+            }
+        }
+
+        if (target == -1)
+        {
+            uint64_t a = b.slots[2].data.load(std::memory_order_relaxed);
+            uint64_t c = b.slots[3].data.load(std::memory_order_relaxed);
+            int shallowReplace = Depth(a) <= Depth(c) ? 2 : 3;
+
+            // Deeper results go in a depth-preferred slot that is empty, shallower or left over from an old search
+            for (int i = 0; i < 2 && target == -1; i++)
+            {
+                uint64_t old = b.slots[i].data.load(std::memory_order_relaxed);
+                if (old == 0 || Generation(old) != generation || depth >= Depth(old))
+                {
+                    target = i;
+                    // The entry being pushed out still beats whatever is in the shallower replace slot
+                    if (old != 0 && Generation(old) == generation)
+                    {
+                        uint64_t oldKey = b.slots[i].check.load(std::memory_order_relaxed) ^ old;
+                        b.slots[shallowReplace].data.store(old, std::memory_order_relaxed);
+                        b.slots[shallowReplace].check.store(oldKey ^ old, std::memory_order_relaxed);
+                    }
+                }
+            }
+            if (target == -1)
+                target = shallowReplace;
+        }
+
+        b.slots[target].data.store(data, std::memory_order_relaxed);
+        b.slots[target].check.store(key ^ data, std::memory_order_relaxed);
+    }
+
+    // Per mille of sampled slots written during the current search
+    int HashFull() const
+    {
+        int used = 0;
+        uint64_t samples = mask + 1 < 250 ? mask + 1 : 250;
+        for (uint64_t i = 0; i < samples; i++)
+            for (const Slot& s : buckets[i].slots)
+            {
+                uint64_t data = s.data.load(std::memory_order_relaxed);
+                if (data != 0 && Generation(data) == generation)
+                    used++;
+            }
+        return (int)(used * 1000 / (samples * 4));
+    }
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include "Bitboard.h"
+
+// Zobrist keys for hashing a game state. The keys come from a fixed-seed
+// generator evaluated at compile time, so every build and every machine gets
+// the same hashes, which replays and desync checks rely on.
+namespace Zobrist {
+
+    const int MineralBuckets = 64; // bank totals are hashed in buckets, see MineralBucket
+    const int MineralBucketSize = 10;
+    const int MaxQueueSlots = 8;
+    const int MaxQueueTurns = 32;
+
+    struct KeyTable {
+        uint64_t pieces[2][PieceTypeCount][64];
+        uint64_t units[64]; // piece on the square was trained
+        uint64_t mineralFields[64];
+        uint64_t blackToMove;
+        uint64_t castling[16];
+        uint64_t enPassant[8]; // by file
+        uint64_t minerals[2][MineralBuckets];
+        uint64_t queueType[2][MaxQueueSlots][PieceTypeCount];
+        uint64_t queueTurns[2][MaxQueueSlots][MaxQueueTurns];
+    };
+
+    constexpr uint64_t SplitMix(uint64_t& state)
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    constexpr KeyTable MakeKeys()
+    {
+        KeyTable k = {};
+        uint64_t state = 0x5C5C5C5C20221010ull;
+        for (auto& side : k.pieces)
+            for (auto& type : side)
+                for (uint64_t& key : type)
+                    key = SplitMix(state);
+        for (uint64_t& key : k.units)
+            key = SplitMix(state);
+        for (uint64_t& key : k.mineralFields)
+            key = SplitMix(state);
+        k.blackToMove = SplitMix(state);
+        // No rights hashes to zero so a fresh board and a cleared one agree
+        for (int i = 1; i < 16; i++)
+            k.castling[i] = SplitMix(state);
+        for (uint64_t& key : k.enPassant)
+            key = SplitMix(state);
+        for (auto& side : k.minerals)
+            for (uint64_t& key : side)
+                key = SplitMix(state);
+        for (auto& side : k.queueType)
+            for (auto& slot : side)
+                for (uint64_t& key : slot)
+                    key = SplitMix(state);
+        for (auto& side : k.queueTurns)
+            for (auto& slot : side)
+                for (uint64_t& key : slot)
+                    key = SplitMix(state);
+        return k;
+    }
+
+    inline constexpr KeyTable Keys = MakeKeys();
+
+    constexpr int MineralBucket(int minerals)
+    {
+        int bucket = minerals / MineralBucketSize;
+        return bucket < MineralBuckets ? bucket : MineralBuckets - 1;
+    }
+
+    constexpr int QueueTurns(int turns)
+    {
+        return turns < MaxQueueTurns ? turns : MaxQueueTurns - 1;
+    }
+}
@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "EndgameTable.h"
+
+// Builds endgame tables by retrograde analysis.
+//
+//   TableGen <dir> [--pieces <n>] [--threads <n>] [<material>...]
+//
+// Without a material list every set with up to --pieces pieces (3 by
+// default, at least one a side) is built, otherwise the ones named ("RvP")
+// and what they can turn into. Tables already in the directory are loaded and
+// reused.
+//
+// Every position starts undecided. Taking a side's last piece reaches a loss
+// in 0, as Match ends the game there. Pass n then marks a position won in n
+// if a move reaches a loss in n - 1, and lost in n if every move reaches a
+// win and the longest is n - 1. Captures and promotions look into the smaller
+// tables built first. A pass that decides nothing after the smaller tables'
+// longest distance ends it, what's left is drawn. Each pass is split over
+// threads by index.
+//
+// A side with nothing to move passes the turn, as in the rest of the game.
+// There are no kings, so nothing is ever in check.
+
+using namespace Endgame;
+
+struct Options {
+    std::string directory;
+    int pieces = 3;
+    int threads = std::max((int)std::thread::hardware_concurrency(), 1);
+    std::vector<MaterialKey> materials;
+};
+
+// A table being built or done, values indexed by its Indexer
+struct BuildTable {
+    Indexer indexer;
+    std::unique_ptr<std::atomic<uint8_t>[]> values;
+    int maxDistance = 0;
+
+    uint8_t Get(uint64_t index) const
+    {
+        return values[index].load(std::memory_order_relaxed);
+    }
+};
+
+class Generator {
+public:
+    Generator(const Options& o) : options(o)
+    {
+    }
+
+    // Builds a table after everything it depends on, false on a write error
+    bool Build(MaterialKey key)
+    {
+        key = Canonical(key);
+        if (tables.count(key))
+            return true;
+        for (MaterialKey dependency : Dependencies(key))
+            if (!Build(dependency))
+                return false;
+        if (Load(key))
+            return true;
+
+        auto start = std::chrono::steady_clock::now();
+        BuildTable& table = tables[key];
+        table.indexer = Indexer(key);
+        table.values = std::make_unique<std::atomic<uint8_t>[]>(table.indexer.size);
+        int subDistance = 0;
+        for (MaterialKey dependency : Dependencies(key))
+            subDistance = std::max(subDistance, tables[Canonical(dependency)].maxDistance);
+
+        uint64_t changed = RunPass(table, 0);
+        int pass = 1;
+        for (; pass <= MaxDistance; pass++)
+        {
+            changed = RunPass(table, pass);
+            if (changed == 0 && pass > subDistance + 1)
+                break;
+        }
+        if (pass > MaxDistance)
+        {
+            std::cerr << MaterialName(key) << ": distances past " << MaxDistance << " don't fit the format" << std::endl;
+            return false;
+        }
+
+        std::vector<uint8_t> values(table.indexer.size);
+        uint64_t counts[3] = {};
+        for (uint64_t i = 0; i < table.indexer.size; i++)
+        {
+            uint8_t v = values[i] = table.Get(i);
+            if (v != Invalid)
+            {
+                counts[IsWin(v) ? 0 : IsLoss(v) ? 2 : 1]++;
+                table.maxDistance = std::max(table.maxDistance, Distance(v));
+            }
+        }
+        std::string path = Path(key);
+        if (!WriteTable(path, key, values))
+        {
+            std::cerr << "can't write " << path << std::endl;
+            return false;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << MaterialName(key) << " positions " << table.indexer.size << " wins " << counts[0] << " draws " << counts[1]
+            << " losses " << counts[2] << " longest " << table.maxDistance << " passes " << pass << " time " << seconds << "s size "
+            << std::filesystem::file_size(path) << std::endl;
+        return true;
+    }
+
+private:
+    const Options& options;
+    std::map<MaterialKey, BuildTable> tables;
+
+    std::string Path(MaterialKey key) const
+    {
+        return (std::filesystem::path(options.directory) / (MaterialName(key) + FileExtension)).string();
+    }
+
+    // Reuses a table written by an earlier run
+    bool Load(MaterialKey key)
+    {
+        Table file;
+        std::string error;
+        if (!std::filesystem::exists(Path(key)) || !file.Open(Path(key), error))
+            return false;
+        BuildTable& table = tables[key];
+        table.indexer = file.indexer;
+        table.values = std::make_unique<std::atomic<uint8_t>[]>(table.indexer.size);
+        for (uint64_t i = 0; i < table.indexer.size; i++)
+        {
+            uint8_t v = file.Value(i);
+            table.values[i].store(v, std::memory_order_relaxed);
+            table.maxDistance = std::max(table.maxDistance, Distance(v));
+        }
+        std::cout << MaterialName(key) << " loaded" << std::endl;
+        return true;
+    }
+
+    // Material one capture, one promotion or a capturing promotion away
+    static std::vector<MaterialKey> Dependencies(MaterialKey key)
+    {
+        std::vector<MaterialKey> result;
+        auto add = [&result](MaterialKey k) {
+            // Without a piece on one side it's over, there's no table for that
+            if (!MaterialPieces(k, White) || !MaterialPieces(k, Black))
+                return;
+            k = Canonical(k);
+            if (std::find(result.begin(), result.end(), k) == result.end())
+                result.push_back(k);
+        };
+        auto shift = [](int side, PieceType t) { return (MaterialKey)1 << ((side * 5 + (int)t) * 4); };
+        for (int side = White; side <= Black; side++)
+            for (PieceType t : MaterialOrder)
+            {
+                if (!MaterialCount(key, side, t))
+                    continue;
+                add(key - shift(side, t));
+                if (t != PieceType::Pawn)
+                    continue;
+                for (PieceType p : { PieceType::Queen, PieceType::Rook, PieceType::Bishop, PieceType::Knight })
+                {
+                    MaterialKey promoted = key - shift(side, t) + shift(side, p);
+                    add(promoted);
+                    for (PieceType c : MaterialOrder)
+                        if (MaterialCount(promoted, side ^ 1, c))
+                            add(promoted - shift(side ^ 1, c));
+                }
+            }
+        return result;
+    }
+
+    // Value of the position after a move, from the new side to move's point of view
+    uint8_t Lookup(const BuildTable& current, const GameState& state) const
+    {
+        if (state.IsEliminated(state.sideToMove))
+            return LossBase;
+        MaterialKey key = MaterialOf(state.board);
+        bool flip = !IsCanonical(key);
+        const BuildTable& table = flip || key != current.indexer.key ? tables.at(flip ? FlipMaterial(key) : key) : current;
+        return table.Get(table.indexer.Index(state, flip));
+    }
+
+    uint64_t RunPass(BuildTable& table, int pass)
+    {
+        const uint64_t ChunkSize = 4096;
+        std::atomic<uint64_t> nextChunk = 0;
+        std::atomic<uint64_t> changed = 0;
+        auto work = [&]() {
+            GameState state;
+            MoveList moves;
+            uint64_t count = 0;
+            for (uint64_t chunk = nextChunk++; chunk * ChunkSize < table.indexer.size; chunk = nextChunk++)
+            {
+                uint64_t end = std::min(table.indexer.size, (chunk + 1) * ChunkSize);
+                for (uint64_t index = chunk * ChunkSize; index < end; index++)
+                    if (table.Get(index) == Draw && Decide(table, index, pass, state, moves))
+                        count++;
+            }
+            changed += count;
+        };
+        std::vector<std::thread> threads;
+        for (int i = 1; i < options.threads; i++)
+            threads.emplace_back(work);
+        work();
+        for (std::thread& t : threads)
+            t.join();
+        return changed;
+    }
+
+    // Works out one undecided position for a pass, true if it got a value
+    bool Decide(BuildTable& table, uint64_t index, int pass, GameState& state, MoveList& moves) const
+    {
+        const Indexer& indexer = table.indexer;
+        int squares[MaxPieces];
+        int sideToMove;
+        uint8_t result = Draw;
+        if (!indexer.Decode(index, squares, sideToMove))
+            result = Invalid;
+        else
+        {
+            state.Clear();
+            for (int i = 0; i < indexer.count; i++)
+            {
+                int y = SquareY(squares[i]);
+                if (indexer.types[i] == PieceType::Pawn && (y == 1 || y == 8))
+                    result = Invalid;
+                state.AddPiece(squares[i], indexer.types[i], indexer.sides[i]);
+            }
+            if (sideToMove == Black)
+                state.SwitchSide();
+        }
+        // Pass 0 only sorts out the indices that aren't positions, nothing is over before a capture
+        if (result == Invalid || pass == 0)
+        {
+            if (result == Draw)
+                return false;
+            table.values[index].store(result, std::memory_order_relaxed);
+            return true;
+        }
+
+        GenerateLegalMoves(state, moves);
+        bool allWins = true;
+        int longest = 0;
+        auto consider = [&](uint8_t v) {
+            if (IsLoss(v) && Distance(v) == pass - 1)
+                result = (uint8_t)pass;
+            if (IsWin(v))
+                longest = std::max(longest, Distance(v));
+            else
+                allWins = false;
+        };
+        if (moves.Empty())
+        {
+            // Nothing to move: the turn passes
+            consider(table.Get(indexer.Index(squares, sideToMove ^ 1)));
+        }
+        for (int i = 0; i < moves.Size() && result == Draw; i++)
+        {
+            UndoInfo undo;
+            state.MakeMove(moves[i], undo);
+            consider(Lookup(table, state));
+            state.UnmakeMove(moves[i], undo);
+        }
+        if (result == Draw && allWins && longest + 1 == pass)
+            result = (uint8_t)(LossBase + pass);
+        if (result == Draw)
+            return false;
+        table.values[index].store(result, std::memory_order_relaxed);
+        return true;
+    }
+};
+
+// Every canonical material set with the given number of pieces and at least one a side
+void AllMaterials(int pieces, std::vector<MaterialKey>& out)
+{
+    std::vector<MaterialKey> keys = { 0 };
+    for (int n = 0; n < pieces; n++)
+    {
+        std::vector<MaterialKey> next;
+        for (MaterialKey key : keys)
+            for (int side = White; side <= Black; side++)
+                for (PieceType t : MaterialOrder)
+                    next.push_back(key + ((MaterialKey)1 << ((side * 5 + (int)t) * 4)));
+        keys = next;
+    }
+    for (MaterialKey key : keys)
+        if (MaterialPieces(key, White) && MaterialPieces(key, Black) && std::find(out.begin(), out.end(), Canonical(key)) == out.end())
+            out.push_back(Canonical(key));
+}
+
+int main(int argc, char** argv)
+{
+    Attacks::Init();
+
+    Options options;
+    bool usage = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        MaterialKey key;
+        if (arg == "--pieces" && i + 1 < argc)
+            options.pieces = std::stoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc)
+            options.threads = std::max(std::stoi(argv[++i]), 1);
+        else if (options.directory.empty() && !arg.empty() && arg[0] != '-')
+            options.directory = arg;
+        else if (ParseMaterialName(arg, key) && MaterialPieces(key) <= MaxPieces)
+            options.materials.push_back(key);
+        else
+            usage = true;
+    }
+    if (usage || options.directory.empty() || options.pieces < 2 || options.pieces > MaxPieces)
+    {
+        std::cerr << "usage: TableGen <dir> [--pieces <2-" << MaxPieces << ">] [--threads <n>] [<material>...]" << std::endl;
+        return 2;
+    }
+    if (options.materials.empty())
+        for (int n = 2; n <= options.pieces; n++)
+            AllMaterials(n, options.materials);
+
+    std::error_code ec;
+    std::filesystem::create_directories(options.directory, ec);
+    Generator generator(options);
+    for (MaterialKey key : options.materials)
+        if (!generator.Build(key))
+            return 1;
+    return 0;
+}